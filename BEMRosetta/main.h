@@ -294,18 +294,41 @@ public:
 	typedef MainView CLASSNAME;
 	
 	MainView() {}
+	~MainView();
 	void Init();
 	void CalcEnvelope();
 	void OnPaint();
 	const WithMenuMeshPlot<StaticRect> &GetMenuPlot() const;
 	const MainMesh &GetMain() const 						{return *main;}			
 	void SetPaintSelect(bool _paintSelect)					{paintSelect = _paintSelect;}
+	virtual void ChildMouseEvent(Ctrl *child, int event, Point p, int zdelta, dword keyflags);
 	
 	VolumeEnvelope env;
+	Function <void(int, int)> WhenPick;		// Mesh id and panel clicked with Ctrl
 	
 private:
 	const MainMesh *main = nullptr;
 	bool paintSelect = true;
+	double modelview[16], projection[16];	// Got when painting, for the picking rays
+	bool painted = false;
+	
+	bool GetRay(Point p, Point3D &from, Point3D &dir) const;
+	
+	// Simplified meshes painted while the view is being moved
+	struct Lod {
+		int version = -1;			// MeshData version they were built from
+		bool building = false;
+		Surface mesh, under;
+	};
+	ArrayMap<int, Lod> lods;		// By MeshData id
+	std::atomic<int> lodThreads{0};
+	std::shared_ptr<bool> alive = std::make_shared<bool>(true);	// Checked by the callbacks posted by the threads
+	int64 lastPaint = 0;
+	
+	static constexpr int lodMinPanels = 100000, lodPanels = 20000;
+	
+	const Lod *GetLod(const MeshData &data);
+	void OnEndMove();
 };
 
 
@@ -316,6 +339,7 @@ public:
 	MainViewDataEach() {}
 	void Init(MeshData &_mesh, MainView &mainView);
 	void OnRefresh();
+	void SelectPanel(int idPanel);
 	
 	TabCtrl tab;
 	Splitter moved, movedUnder;
@@ -367,6 +391,7 @@ public:
 	void OnRefresh();
 	void Clear();
 	void ReLoad(MainView &mainView);
+	void SelectPanel(int idMesh, int idPanel);
 	
 private:
 	TabCtrl tab;
@@ -802,6 +827,7 @@ public:
 	
 	bool Get(Upp::Vector<int> &ibs, Upp::Vector<int> &idfs, Upp::Vector<int> &jdfs,
 		Upp::Vector<double> &froms, Upp::Vector<double> &tos, Upp::Vector<Upp::Vector<double>> &freqs); 
+	bool IsCaseCancelled(int icase) const	{return !bool(arrayCases.Get(caseRows[icase], 0));}
 	void Clear();
 	
 	MainPlot plots;
@@ -810,6 +836,7 @@ public:
 
 private:
 	Upp::Array<Option> options;
+	Upp::Vector<int> caseRows;		// arrayCases row of each case got in Get()
 	int id = -1;
 	RectEnterSet frameSet;
 };
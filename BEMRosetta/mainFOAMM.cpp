@@ -98,6 +98,7 @@ void MenuFOAMM::Init(MainBEM &mainBEM, MainSetupFOAMM &_setup) {
 	progress.Hide();
 	butCancel.Hide();
 	butCancel << [&] {isCancelled = true;};
+	numThreads <<= CPU_Cores();
 }
 
 void MainSetupFOAMM::WhenFocus() {
@@ -285,9 +286,11 @@ String MainSetupFOAMM::Check(double fromFreq, double toFreq, String freqs) {
 
 bool MainSetupFOAMM::Get(Upp::Vector<int> &ibs, Upp::Vector<int> &idfs, Upp::Vector<int> &jdfs,
 		Upp::Vector<double> &froms, Upp::Vector<double> &tos, Upp::Vector<Upp::Vector<double>> &freqs) {
+	caseRows.Clear();
 	for (int row = 0; row < arrayCases.GetCount(); ++row) {
 		bool proc = arrayCases.Get(row, 0);
 		if (proc) {
+			caseRows << row;
 			int ib = int(arrayCases.Get(row, 1))-1;
 			ibs << ib;
 			String sidf = arrayCases.Get(row, 2);
@@ -371,7 +374,9 @@ bool MenuFOAMM::OnFOAMM() {
 					Exclamation(t_("FOAMM message:&") + DeQtfLf(str));
 				}
 				ProcessEvents(); 
-			});
+			},
+			[&](int icase) {return setup->IsCaseCancelled(icase);},	// Unchecking a running case cancels it
+			~numThreads);
 	} catch (Exc e) {
 		ret = DeQtfLf(e);
 	}
@@ -180,6 +180,7 @@ void MainMesh::Init() {
 	mainVAll.Tip(t_("")).WhenAction = [&] {mainView.SetPaintSelect(mainVAll.GetPos() < 9900);};
 	mainTab.Add(mainVAll.SizePos(), t_("View"));
 	mainView.Init();
+	mainView.WhenPick = [&](int idMesh, int idPanel) {mainViewData.SelectPanel(idMesh, idPanel);};
 	
 	mainSummary.Init();
 	mainTab.Add(mainSummary.SizePos(), t_("Summary"));
@@ -517,19 +518,16 @@ void MainMesh::OnUpdate(Action action) {
 		
 		WaitCursor wait;
 
-		if (action == MOVE) {
-			data.cg.Translate(t_x, t_y, t_z);
-			data.mesh.Translate(t_x, t_y, t_z);
-		} else if (action == ROTATE) {
-			data.cg.Rotate(a_x, a_y, a_z, c_x, c_y, c_z);
-			data.mesh.Rotate(a_x, a_y, a_z, c_x, c_y, c_z);
-		} else if (action == NONE) {
+		if (action == MOVE)
+			data.Translate(t_x, t_y, t_z, Bem().rho, Bem().g);
+		else if (action == ROTATE)
+			data.Rotate(a_x, a_y, a_z, c_x, c_y, c_z, Bem().rho, Bem().g);
+		else if (action == NONE) {
 			data.mass = mass;
 			data.cg.Set(cg_x, cg_y, cg_z);
+			data.AfterLoad(Bem().rho, Bem().g, true);
 		}
 		
-		data.AfterLoad(Bem().rho, Bem().g, action == NONE);
-		
 	 	mainStiffness.Load(Bem().surfs, ids);
 		mainView.CalcEnvelope();
 		mainSummary.Report(Bem().surfs, id);
@@ -818,7 +816,7 @@ void MainMesh::OnImage(int axis) {
 		else
 			data.cg.z = -data.cg.z;
 		
-		data.mesh.Image(axis);
+		data.Image(axis);
 	
 		data.AfterLoad(Bem().rho, Bem().g, false);
 		
@@ -1176,7 +1174,126 @@ void MainView::Init() {
 	gl.WhenPaint = THISBACK(OnPaint);	
 }
 	
+// Waits for the simplified meshes being built, and discards the callbacks they have posted
+MainView::~MainView() {
+	*alive = false;
+	while (lodThreads > 0)
+		Sleep(1);
+}
+
+// Returns the simplified meshes of data if they are ready, launching their build in a thread if they are not
+const MainView::Lod *MainView::GetLod(const MeshData &data) {
+	if (data.mesh.panels.size() < lodMinPanels)
+		return nullptr;
+	
+	Lod &lod = lods.GetAdd(data.GetId());
+	if (lod.version == data.GetVersion())
+		return &lod;
+	if (!lod.building) {
+		lod.building = true;
+		int id = data.GetId(), version = data.GetVersion();
+		auto mesh = std::make_shared<Surface>(), under = std::make_shared<Surface>();
+		mesh->nodes = clone(data.mesh.nodes);
+		mesh->panels = clone(data.mesh.panels);
+		under->nodes = clone(data.under.nodes);
+		under->panels = clone(data.under.panels);
+		std::shared_ptr<bool> _alive = alive;
+		lodThreads++;
+		Thread::Start([=] {
+			auto lodMesh = std::make_shared<Surface>(), lodUnder = std::make_shared<Surface>();
+			MeshData::Decimate(mesh->nodes, mesh->panels, lodPanels, *lodMesh);
+			MeshData::Decimate(under->nodes, under->panels, lodPanels, *lodUnder);
+			lodMesh->GetPanelParams();
+			lodUnder->GetPanelParams();
+			PostCallback([=] {
+				if (!*_alive)				// The view has been closed
+					return;
+				int i = lods.Find(id);
+				if (i < 0)
+					return;
+				Lod &lod = lods[i];
+				lod.building = false;
+				lod.version = version;
+				lod.mesh = pick(*lodMesh);
+				lod.under = pick(*lodUnder);
+			});
+			lodThreads--;
+		});
+	}
+	return lod.version < 0 ? nullptr : &lod;		// An older version is better than nothing while moving
+}
+
+void MainView::OnEndMove() {
+	for (int i = lods.size()-1; i >= 0; --i) {		// Removed meshes
+		bool found = false;
+		for (const MeshData &data : Bem().surfs)
+			if (data.GetId() == lods.GetKey(i))
+				found = true;
+		if (!found && !lods[i].building)
+			lods.Remove(i);
+	}
+	lastPaint = 0;
+	gl.Refresh();
+}
+
+// Ray through the point p of the canvas, from the near to the far clipping planes
+bool MainView::GetRay(Point p, Point3D &from, Point3D &dir) const {
+	Size sz = gl.GetSize();
+	if (!painted || sz.cx <= 0 || sz.cy <= 0)
+		return false;
+	
+	double x = 2.*p.x/sz.cx - 1, y = 1 - 2.*p.y/sz.cy;
+	Eigen::Matrix4d inv = (Eigen::Map<const Eigen::Matrix4d>(projection)*Eigen::Map<const Eigen::Matrix4d>(modelview)).inverse();
+	Eigen::Vector4d pnear = inv*Eigen::Vector4d(x, y, -1, 1), pfar = inv*Eigen::Vector4d(x, y, 1, 1);
+	if (pnear(3) == 0 || pfar(3) == 0)
+		return false;
+	Eigen::Vector3d a = pnear.head<3>()/pnear(3), b = pfar.head<3>()/pfar(3);
+	from = Point3D(a(0), a(1), a(2));
+	dir = Point3D(b(0) - a(0), b(1) - a(1), b(2) - a(2));
+	return true;
+}
+
+// Ctrl + click selects the closest panel under the mouse
+void MainView::ChildMouseEvent(Ctrl *child, int event, Point p, int zdelta, dword keyflags) {
+	if (child == &gl && event == LEFTDOWN && (keyflags & K_CTRL)) {
+		Point3D from, dir;
+		if (GetRay(p, from, dir)) {
+			int idMesh = -1, idPanel = -1;
+			double minDist = DBL_MAX;
+			for (int row = 0; row < GetMain().listLoaded.GetCount(); ++row) {
+				if (!ArrayModel_IsVisible(GetMain().listLoaded, row))
+					continue;
+				int id = ArrayModel_IdMesh(GetMain().listLoaded, row);
+				if (id < 0)
+					continue;
+				double dist;
+				int ip = Bem().surfs[id].PickPanel(from, dir, dist);
+				if (ip >= 0 && dist < minDist) {
+					minDist = dist;
+					idMesh = id;
+					idPanel = ip;
+				}
+			}
+			if (idPanel >= 0)
+				WhenPick(idMesh, idPanel);
+		}
+	}
+	WithMainView<StaticRect>::ChildMouseEvent(child, event, p, zdelta, keyflags);
+}
+
 void MainView::OnPaint() {
+	glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+	glGetDoublev(GL_PROJECTION_MATRIX, projection);
+	painted = true;
+	
+	// Paints in a quick sequence come from the view being moved, so simplified meshes are used
+	// until it stops for a while
+	int64 now = msecs();
+	bool moving = now - lastPaint < 200;
+	lastPaint = now;
+	if (moving)
+		KillSetTimeCallback(300, THISBACK(OnEndMove), 0);
+	
 	gl.SetLineThickness(~GetMenuPlot().lineThickness);
 	gl.SetBackgroundColor(~GetMenuPlot().backColor);
 	
@@ -1201,10 +1318,11 @@ void MainView::OnPaint() {
 			const Upp::Color &color = ArrayModel_GetColor(GetMain().listLoaded, row);
 			const MeshData &mesh = Bem().surfs[id];
 			
-			gl.PaintSurface(mesh.mesh, color, ~GetMenuPlot().showMesh, 	
+			const Lod *lod = moving ? GetLod(mesh) : nullptr;
+			gl.PaintSurface(lod ? lod->mesh : mesh.mesh, color, ~GetMenuPlot().showMesh, 	
 				showNormals);
 				
-			gl.PaintSurface(mesh.under, color, ~GetMenuPlot().showUnderwater, 
+			gl.PaintSurface(lod ? lod->under : mesh.under, color, ~GetMenuPlot().showUnderwater, 
 				showNormalsUnderwater);
 			
 			if (~GetMenuPlot().showSkewed)
@@ -1336,6 +1454,13 @@ void MainViewData::Clear() {
 	tab.Reset();
 }
 
+void MainViewData::SelectPanel(int idMesh, int idPanel) {
+	if (idMesh < 0 || idMesh >= models.size())
+		return;
+	tab.Set(idMesh);
+	models[idMesh].SelectPanel(idPanel);
+}
+
 void MainViewData::ReLoad(MainView &mainView) {
 	Clear();
 	
@@ -1521,6 +1646,17 @@ void MainViewDataEach::Init(MeshData &_mesh, MainView &mainView) {
 	timeCallback.Set(-1000, THISBACK(OnTimer));
 }
 
+void MainViewDataEach::SelectPanel(int idPanel) {
+	tab.Set(0);
+	ArrayCtrl &array = arrayFacetsAll2.array;
+	if (idPanel >= array.GetCount())
+		return;
+	array.ClearSelection();
+	array.SetCursor(idPanel);
+	array.Select(idPanel);
+	array.CenterCursor();
+}
+
 void MainViewDataEach::OnRefresh() {
 	const MeshData &mesh = dataSourceFacetsAll[0].GetMesh();
 	int num;
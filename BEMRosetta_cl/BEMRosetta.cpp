@@ -7,9 +7,19 @@
 
 using namespace Upp;
 
-Function <void(String)> BEMData::Print 		  = [](String s) {Cout() << s;};
-Function <void(String)> BEMData::PrintWarning = [](String s) {Cout() << s;};
-Function <void(String)> BEMData::PrintError   = [](String s) {Cout() << s;};
+Function <void(String)> BEMData::Print 		  = [](String s) {ConsoleOut() << s;};
+Function <void(String)> BEMData::PrintWarning = [](String s) {ConsoleOut() << s;};
+Function <void(String)> BEMData::PrintError   = [](String s) {ConsoleOut() << s;};
+
+static thread_local Stream *consoleOut = nullptr;	// Per thread output, so server requests don't mix
+
+Stream &ConsoleOut() 			{return consoleOut ? *consoleOut : Cout();}
+// Returns the previous one, nullptr for Cout(), so it can be restored exactly
+Stream *SetConsoleOut(Stream *out) {
+	Stream *prev = consoleOut;
+	consoleOut = out;
+	return prev;
+}
 
 const char *Hydro::strDOF[] 	 = {t_("surge"), t_("sway"), t_("heave"), t_("roll"), t_("pitch"), t_("yaw")};
 const char *Hydro::strDOFAbrev[] = {t_("s"), t_("w"), t_("h"), t_("r"), t_("p"), t_("y")};
@@ -18,7 +28,7 @@ const char *Hydro::strDataToPlot[] = {t_("A(ω)"), t_("A∞"), t_("A0"), t_("B(
 				t_("RAO_ma"), t_("RAO_ph"), t_("Z_ma"), t_("Z_ph"), t_("Kr_ma"), t_("Kr_ph"), 
 				t_("TFS_ma"), t_("TFS_ph")};
 
-int Hydro::idCount = 0;	
+std::atomic<int> Hydro::idCount(0);	
 
 void Hydro::InitializeSts() {
 	sts.SetCount(6*Nb);
@@ -282,6 +292,7 @@ void Hydro::Symmetrize_Forces(bool xAxis) {
 }
 
 void Hydro::RemoveThresDOF_A(double thres) {
+	BEM_PROFILE("Hydro::RemoveThresDOF_A");
 	if (!IsLoadedA())
 		return;
 	for (int idf = 0; idf < 6*Nb; ++idf) {
@@ -309,6 +320,7 @@ void Hydro::RemoveThresDOF_A(double thres) {
 }
 
 void Hydro::RemoveThresDOF_B(double thres) {
+	BEM_PROFILE("Hydro::RemoveThresDOF_B");
 	if (!IsLoadedB())
 		return;
 	for (int idf = 0; idf < 6*Nb; ++idf) {
@@ -335,6 +347,7 @@ void Hydro::RemoveThresDOF_B(double thres) {
 }
 
 void Hydro::RemoveThresDOF_Force(Forces &f, double thres) {
+	BEM_PROFILE("Hydro::RemoveThresDOF_Force");
 	if (!IsLoadedForce(f))
 		return;
 	for (int h = 0; h < Nh; ++h) {
@@ -457,6 +470,7 @@ void Hydro::Compare_cg(Hydro &a) {
 }
 
 void Hydro::SaveAs(String file, BEM_SOFT type, int qtfHeading) {
+	BEM_PROFILE("Hydro::SaveAs");
 	int realNh = Nh;
 	int realNf = Nf;
 	
@@ -754,6 +768,7 @@ void Hydro::GetBodyDOF() {
 }
 
 bool Hydro::AfterLoad(Function <bool(String, int)> Status) {
+	BEM_PROFILE("Hydro::AfterLoad");
 	if (dofOrder.IsEmpty()) {
 		dofOrder.SetCount(6*Nb);
 		for (int i = 0, order = 0; i < 6*Nb; ++i, ++order) 
@@ -816,6 +831,7 @@ void Hydro::Get3W0(int &id1, int &id2, int &id3) {
 }
 
 void Hydro::GetA0() {
+	BEM_PROFILE("Hydro::GetA0");
 	if (!IsLoadedA())
 		return;
 	
@@ -908,15 +924,6 @@ double Hydro::rho_ndim()	const {return !IsNull(rho) ? rho : bem->rho;}
 double Hydro::g_rho_dim() 	const {return bem->rho*bem->g;}
 double Hydro::g_rho_ndim()	const {return g_ndim()*rho_ndim();}
 
-void Hydro::StateSpace::GetTFS(const Upp::Vector<double> &w) {
-	Eigen::Index sz = A_ss.rows();
-	TFS.SetCount(w.size());
-	for (int ifr = 0; ifr < w.size(); ++ifr) {
-		std::complex<double> wi = std::complex<double>(0, w[ifr]);
-		TFS[ifr] = (C_ss.transpose()*(Eigen::MatrixXd::Identity(sz, sz)*wi - A_ss).inverse()*B_ss)(0);	// C_ss*inv(I*w*i-A_ss)*B_ss
-	}		
-}
-
 int Hydro::GetHeadId(double hd) const {
 	for (int i = 0; i < head.size(); ++i) {
 		if (EqualRatio(head[i], hd, 0.01))
@@ -1076,6 +1083,94 @@ void Hydro::Jsonize(JsonIO &json) {
 	}
 }
 	
+static void CopyForces(Hydro::Forces &to, const Hydro::Forces &from) {
+	to.ma = clone(from.ma);
+	to.ph = clone(from.ph);
+	to.re = clone(from.re);
+	to.im = clone(from.im);
+}
+
+static void CopyQTF(Upp::Array<Hydro::QTF> &to, const Upp::Array<Hydro::QTF> &from) {
+	to.SetCount(from.size());
+	for (int i = 0; i < to.size(); ++i) {
+		Hydro::QTF &q = to[i];
+		const Hydro::QTF &qf = from[i];
+		q.Set(qf.ib, qf.ih1, qf.ih2, qf.ifr1, qf.ifr2);
+		q.fre = clone(qf.fre);
+		q.fim = clone(qf.fim);
+		q.fma = clone(qf.fma);
+		q.fph = clone(qf.fph);
+	}
+}
+
+// Deep copy of all the data, except the BEMData it belongs to and the id
+void Hydro::Copy(const Hydro &hyd) {
+	file = hyd.file;
+	name = hyd.name;
+	g = hyd.g;
+	h = hyd.h;
+	rho = hyd.rho;
+	len = hyd.len;
+	dimen = hyd.dimen;
+	Nb = hyd.Nb;
+	Nf = hyd.Nf;
+	Nh = hyd.Nh;
+	
+	A = clone(hyd.A);
+	Ainfw = clone(hyd.Ainfw);
+	Awinf = hyd.Awinf;
+	Aw0 = hyd.Aw0;
+	B = clone(hyd.B);
+	head = clone(hyd.head);
+	names = clone(hyd.names);
+	C = clone(hyd.C);
+	M = clone(hyd.M);
+	cb = hyd.cb;
+	cg = hyd.cg;
+	code = hyd.code;
+	dof = clone(hyd.dof);
+	dofOrder = clone(hyd.dofOrder);
+	Kirf = clone(hyd.Kirf);
+	Tirf = hyd.Tirf;
+	
+	CopyForces(ex, hyd.ex);
+	CopyForces(sc, hyd.sc);
+	CopyForces(fk, hyd.fk);
+	CopyForces(rao, hyd.rao);
+	
+	sts.SetCount(hyd.sts.size());
+	for (int i = 0; i < sts.size(); ++i) {
+		sts[i].SetCount(hyd.sts[i].size());
+		for (int j = 0; j < sts[i].size(); ++j) {
+			StateSpace &to = sts[i][j];
+			const StateSpace &from = hyd.sts[i][j];
+			to.TFS = clone(from.TFS);
+			to.A_ss = from.A_ss;
+			to.B_ss = from.B_ss;
+			to.C_ss = from.C_ss;
+			to.ssFrequencies = from.ssFrequencies;
+			to.ssFreqRange = from.ssFreqRange;
+			to.ssFrequencies_index = from.ssFrequencies_index;
+			to.ssMAE = from.ssMAE;
+		}
+	}
+	dimenSTS = hyd.dimenSTS;
+	stsProcessor = hyd.stsProcessor;
+	description = hyd.description;
+	
+	CopyQTF(qtfsum, hyd.qtfsum);
+	CopyQTF(qtfdif, hyd.qtfdif);
+	qtfw = clone(hyd.qtfw);
+	qtfT = clone(hyd.qtfT);
+	qtfhead = clone(hyd.qtfhead);
+	qtfdataFromW = hyd.qtfdataFromW;
+	
+	T = clone(hyd.T);
+	w = clone(hyd.w);
+	dataFromW = hyd.dataFromW;
+	Vo = clone(hyd.Vo);
+}
+
 BEMData::BEMData() {
 	bemFilesAst = clone(bemFilesExt);
 	bemFilesAst.Replace(".", "*.");
@@ -1083,6 +1178,7 @@ BEMData::BEMData() {
 }
 
 void BEMData::Load(String file, Function <bool(String, int)> Status, bool checkDuplicated) {
+	BEM_PROFILE("BEMData::Load");
 	Status(t_("Loading files"), 10);
 	if (checkDuplicated) {
 		for (int i = 0; i < hydros.size(); ++i) {
@@ -1157,6 +1253,8 @@ void BEMData::Load(String file, Function <bool(String, int)> Status, bool checkD
 		hydros.SetCount(hydros.size()-1);
 		throw Exc(Format(t_("Problem processing '%s'\n%s"), file, error));	
 	}
+	BEM_PROFILE_COUNT("Models loaded", 1);
+	BEM_PROFILE_COUNT("Frequencies loaded", justLoaded.Nf);
 	
 	if (discardNegDOF) {
 		if (!Status(t_("Discarding negligible DOF"), 90)) {
@@ -1229,6 +1327,7 @@ void BEMData::Ainfw(int id) {
 }
 
 void BEMData::LoadMesh(String fileName, Function <void(String, int pos)> Status, bool cleanPanels, bool checkDuplicated) {
+	BEM_PROFILE("BEMData::LoadMesh");
 	Status(Format(t_("Loaded mesh '%s'"), fileName), 10);
 	
 	if (checkDuplicated) {
@@ -1321,19 +1420,26 @@ Upp::Vector<int> BEMData::SplitMesh(int id, Function <void(String, int pos)> Sta
 	
 	Upp::Vector<int> ret;
 	try {
-		Upp::Vector<Upp::Vector<int>> sets = orig.mesh.GetPanelSets(Status);
+		Upp::Vector<Upp::Vector<int>> sets = MeshData::GetPanelSets(orig.mesh);
 		if (sets.size() == 1)
 			return ret;
+		Status(Format(t_("Splitting mesh '%s' in %d parts"), orig.fileName, sets.size()), 50);
+		
+		Upp::Vector<MeshData *> parts;
 		for (int i = 0; i < sets.size(); ++i) {		
-			MeshData &surf = surfs.Add();
+			parts << &surfs.Add();
 			ret << surfs.size()-1-1;		// One more as id is later removed
-			for (int ii = 0; ii < sets[i].size(); ++ii) 
-				surf.mesh.panels << clone(orig.mesh.panels[sets[i][ii]]);	
-			
-			surf.mesh.nodes = clone(orig.mesh.nodes);
-			surf.SetCode(orig.GetCode());
-			surf.AfterLoad(rho, g, false);
 		}
+		CoWork co;
+		for (int i = 0; i < sets.size(); ++i) {
+			co & [&, i] {
+				MeshData &surf = *parts[i];
+				MeshData::ExtractPanels(orig.mesh, sets[i], surf.mesh);
+				surf.SetCode(orig.GetCode());
+				surf.AfterLoad(rho, g, false);
+			};
+		}
+		co.Finish();
 		RemoveMesh(id);
 	} catch (Exc e) {
 		surfs.SetCount(surfs.size() - ret.size());
@@ -1442,6 +1548,9 @@ bool BEMData::LoadSerializeJson(bool &firstTime) {
 		numValsA = 1000;
 	if (!ret || IsNull(onlyDiagonal))
 		onlyDiagonal = false;
+	if (!ret || IsNull(meshCacheSize) || meshCacheSize < 0)
+		meshCacheSize = 500;
+	MeshData::SetCacheMaxSize(int64(meshCacheSize) << 20);
 	
 	firstTime = !ret;
 	return true;
@@ -1463,6 +1572,7 @@ bool BEMData::StoreSerializeJson() {
 
 
 bool HydroClass::Load(String file) {
+	BEM_PROFILE("HydroClass::Load");
 	BEMData::Print("\n\n" + Format(t_("Loading '%s'"), file));
 	
 	if (!LoadFromJsonFile(hd(), file)) {
@@ -1475,6 +1585,7 @@ bool HydroClass::Load(String file) {
 }
 	
 bool HydroClass::Save(String file) {
+	BEM_PROFILE("HydroClass::Save");
 	BEMData::Print("\n\n" + Format(t_("Saving '%s'"), file));
 	if (!StoreAsJsonFile(hd(), file, true)) {
 		BEMData::PrintError("\n" + Format(t_("Error saving '%s'"), file));
@@ -1537,26 +1648,74 @@ void FieldSplitWamit::LoadWamitJoinedFields(String _line) {
 }
 	
 void ShowHelp(BEMData &md) {
-	Cout() << "\n" << t_("Usage: bemrosetta_cl [options] [-i infile]... [-e outfile]");
-	Cout() << "\n";
-	Cout() << "\n" << t_("Options:");
-	Cout() << "\n" << t_("-h  --help     -- print options");
-	Cout() << "\n" << t_("-p  --params   -- set physical parameters:");
-	Cout() << "\n" << t_("                 parameter description   units  default value");
-	Cout() << "\n" << t_("                    g      gravity       [m/s2]    ") << md.g;
-	Cout() << "\n" << t_("                    length length scale  []        ") << md.len;
-	Cout() << "\n" << t_("                    rho    water density [Kg/m3]   ") << md.rho;
-	Cout() << "\n" << t_("                    depth  water depth   [m]       ") << md.depth;
-	//Cout() << "\n" << t_("                    thres  threshold to discard DOF") << md.thres;
-	Cout() << "\n" << t_("-i  --input    -- load model");
-	Cout() << "\n" << t_("-e  --export   -- export from input file to output file");
-	Cout() << "\n" << t_("-c  --compare  -- compare input files");
-	Cout() << "\n" << t_("-r  --report   -- output last loaded model data");
-	Cout() << "\n" << t_("-cl --clear    -- clear loaded model");
-	Cout() << "\n";
-	Cout() << "\n" << t_("Actions");
-	Cout() << "\n" << t_("- are done in sequence: if a physical parameter is changed after export, saved files will not include the change");
-	Cout() << "\n" << t_("- can be repeated as desired");
+	ConsoleOut() << "\n" << t_("Usage: bemrosetta_cl [options] [-i infile]... [-e outfile]");
+	ConsoleOut() << "\n";
+	ConsoleOut() << "\n" << t_("Options:");
+	ConsoleOut() << "\n" << t_("-h  --help     -- print options");
+	ConsoleOut() << "\n" << t_("-p  --params   -- set physical parameters:");
+	ConsoleOut() << "\n" << t_("                 parameter description   units  default value");
+	ConsoleOut() << "\n" << t_("                    g      gravity       [m/s2]    ") << md.g;
+	ConsoleOut() << "\n" << t_("                    length length scale  []        ") << md.len;
+	ConsoleOut() << "\n" << t_("                    rho    water density [Kg/m3]   ") << md.rho;
+	ConsoleOut() << "\n" << t_("                    depth  water depth   [m]       ") << md.depth;
+	//ConsoleOut() << "\n" << t_("                    thres  threshold to discard DOF") << md.thres;
+	ConsoleOut() << "\n" << t_("-i  --input    -- load model");
+	ConsoleOut() << "\n" << t_("-e  --export   -- export from input file to output file");
+	ConsoleOut() << "\n" << t_("-c  --compare  -- compare input files");
+	ConsoleOut() << "\n" << t_("-r  --report   -- output last loaded model data");
+	ConsoleOut() << "\n" << t_("-he --heal     -- heal A and B of last loaded model, getting A∞(ω), A∞ and Kirf");
+	ConsoleOut() << "\n" << t_("-rw --resample -- resample the frequencies of last loaded model");
+	ConsoleOut() << "\n" << t_("                 -rw <from w> <to w> <number of w> [cubic|qtf]");
+	ConsoleOut() << "\n" << t_("                 w in [rad/s]. cubic: cubic instead of linear interpolation. qtf: resample the QTF frequencies");
+	ConsoleOut() << "\n" << t_("-rh --resamplehead -- resample the wave headings of the forces and RAO of last loaded model");
+	ConsoleOut() << "\n" << t_("                 -rh <from head> <to head> <number of headings>");
+	ConsoleOut() << "\n" << t_("                 head in [deg]. Headings out of the model ones are left empty. QTF headings are kept");
+	ConsoleOut() << "\n" << t_("-ss --statespace -- get the radiation state space of last loaded model by rational fitting");
+	ConsoleOut() << "\n" << t_("                 -ss <max order> <max error> [<from w> <to w>]");
+	ConsoleOut() << "\n" << t_("                 order is increased until the relative mean error is below max error. w in [rad/s]");
+	ConsoleOut() << "\n" << t_("-ra --rao      -- get the RAO of last loaded model, so they can be exported");
+	ConsoleOut() << "\n" << t_("                 -ra [M|Dlin|Dquad|Cmoor <matrix file>]...");
+	ConsoleOut() << "\n" << t_("                 dimensional 6*Nb x 6*Nb matrices, a row per line. M is required if the model has no mass matrix");
+	ConsoleOut() << "\n" << t_("-rs --response -- get response statistics of last loaded model for the sea states in a csv file");
+	ConsoleOut() << "\n" << t_("                 -rs <sea states file> <results file>");
+	ConsoleOut() << "\n" << t_("                 sea states file columns: Hs [m], Tp [s], gamma, heading [deg], duration [s]");
+	ConsoleOut() << "\n" << t_("-ts --timeseries -- get the wave excitation force series of last loaded model, for the sea states in a csv file");
+	ConsoleOut() << "\n" << t_("                 -ts <sea states file> <duration [s]> <time step [s]> <results file> [newman|full]");
+	ConsoleOut() << "\n" << t_("                 newman|full: add the slow drift forces from the difference frequency QTF, for the same waves");
+	ConsoleOut() << "\n" << t_("                 results are saved in FAST .out format, a file per sea state if there are many");
+	ConsoleOut() << "\n" << t_("-td --timedomain -- simulate last loaded model in time domain with Cummins equation, for the sea states in a csv file");
+	ConsoleOut() << "\n" << t_("                 -td <sea states file> <duration [s]> <time step [s]> <results file> [M|Dlin|Dquad|Cmoor <matrix file>]... [ss]");
+	ConsoleOut() << "\n" << t_("                 matrices as in -ra. M is required if the model has no mass matrix");
+	ConsoleOut() << "\n" << t_("                 ss: radiation memory from the state space instead of Kirf");
+	ConsoleOut() << "\n" << t_("                 results are saved in FAST .out format, a file per sea state if there are many");
+	ConsoleOut() << "\n" << t_("-gz --gz       -- get the equilibrium and the GZ curves of a mesh in a csv file");
+	ConsoleOut() << "\n" << t_("                 -gz <mesh file> <mass [kg]> <cg_x> <cg_y> <cg_z> <results file> [<max heel> <heel step> <heading step>]");
+	ConsoleOut() << "\n" << t_("                 angles in [deg]. Defaults are 90, 5 and 360 (only heel around x axis)");
+	ConsoleOut() << "\n" << t_("-cl --clear    -- clear loaded model");
+	ConsoleOut() << "\n" << t_("-pf --profile  -- show the time spent in load, processing and save stages when finished");
+	ConsoleOut() << "\n" << t_("                 -pf [<Chrome trace json file>]");
+	ConsoleOut() << "\n" << t_("                 not available through the server");
+	ConsoleOut() << "\n" << t_("-sv --server   -- run as a local server, keeping loaded models in memory");
+	ConsoleOut() << "\n" << t_("                 -sv [<port>]");
+	ConsoleOut() << "\n" << t_("                 only clients of the same user are served, as they read a key saved in the user data folder");
+	ConsoleOut() << "\n" << t_("-ct --client   -- send the rest of arguments to the local server");
+	ConsoleOut() << "\n" << t_("                 -ct [<port>] <arguments>");
+	ConsoleOut() << "\n" << t_("-t  --threads  -- set the number of threads used in batch conversion. Default is the number of cores");
+	ConsoleOut() << "\n" << t_("-b  --batch    -- convert many models in parallel");
+	ConsoleOut() << "\n" << t_("                 -b <folder, file pattern or list file> <output extension> [<output folder>]");
+	ConsoleOut() << "\n" << t_("                 a line is printed per file: BATCH OK|ERROR input output seconds message");
+	ConsoleOut() << "\n" << t_("-mc --meshcache -- load the meshes in a folder and its subfolders, saving their cache so they load faster later");
+	ConsoleOut() << "\n" << t_("                 -mc <folder> [clean]");
+	ConsoleOut() << "\n" << t_("                 clean: cache meshes with duplicated panels and nodes removed");
+	ConsoleOut() << "\n" << t_("                 a line is printed per file: CACHE OK|ERROR file seconds message");
+	ConsoleOut() << "\n" << t_("-mcs --meshcachesize -- set the maximum size of the mesh cache in MB. 0 disables it");
+	ConsoleOut() << "\n" << t_("                 -mcs <size> [save]");
+	ConsoleOut() << "\n" << t_("                 save: keep it in the configuration");
+	ConsoleOut() << "\n" << t_("-mcc --meshcacheclear -- delete the mesh cache");
+	ConsoleOut() << "\n";
+	ConsoleOut() << "\n" << t_("Actions");
+	ConsoleOut() << "\n" << t_("- are done in sequence: if a physical parameter is changed after export, saved files will not include the change");
+	ConsoleOut() << "\n" << t_("- can be repeated as desired");
 }
 
 void CheckNumArgs(const Upp::Vector<String>& command, int i, String param) {
@@ -1564,6 +1723,35 @@ void CheckNumArgs(const Upp::Vector<String>& command, int i, String param) {
 		throw Exc(Format(t_("Missing parameters when reading '%s'"), param));
 }
 
+double GetDoubleArg(const Upp::Vector<String>& command, int i, String param) {
+	CheckNumArgs(command, i, param);
+	double ret = ScanDouble(command[i]);
+	if (IsNull(ret))
+		throw Exc(Format(t_("Wrong argument '%s'"), command[i]));
+	return ret;
+}
+
+// Name of the results file of case id, when there are num cases
+static String GetCaseFileName(String fileName, int id, int num) {
+	if (num <= 1)
+		return fileName;
+	return AppendFileName(GetFileFolder(fileName), GetFileTitle(fileName) + Format("_%d", id+1) + GetFileExt(fileName));
+}
+
+// Reads the optional "M|Dlin|Dquad|Cmoor <matrix file>" arguments that follow command[i]
+static void GetDynMatricesArgs(const Upp::Vector<String>& command, int &i, String param, 
+				Eigen::MatrixXd &M, Eigen::MatrixXd &Dlin, Eigen::MatrixXd &Dquad, Eigen::MatrixXd &Cmoor) {
+	while (i+1 < command.size()) {
+		String name = command[i+1];
+		Eigen::MatrixXd *m = name == "M" ? &M : name == "Dlin" ? &Dlin : name == "Dquad" ? &Dquad : name == "Cmoor" ? &Cmoor : nullptr;
+		if (!m)
+			break;
+		i += 2;
+		CheckNumArgs(command, i, param + " " + name);
+		Hydro::LoadMatrix(command[i], *m);
+	}
+}
+
 void ConsoleMain(const Upp::Vector<String>& command, bool gui) {	
 	String str = t_("BEMRosetta Copyright (c) 2019 Iñaki Zabala\nHydrodynamic coefficients converter for Boundary Element Method solver formats\nVersion beta BUILDINFO");
 	SetBuildInfo(str);
@@ -1575,10 +1763,20 @@ void ConsoleMain(const Upp::Vector<String>& command, bool gui) {
 	if (!md.LoadSerializeJson(firstTime))
 		Cout() << "\n" << t_("BEM configuration data are not loaded. Defaults are set");
 	
+	ConsoleProcess(md, command, gui, nullptr);
+	Cout() << "\n";
+}
+
+// Processes the command arguments with md. Output goes to ConsoleOut().
+// If cache is not null, it is a server request and models are got from the cache
+void ConsoleProcess(BEMData &md, const Upp::Vector<String>& command, bool gui, HydroCache *cache) {
+	int numThreads = Null;
+	String traceFile;
+	
 	String errorStr;
 	try {
 		if (command.IsEmpty()) {
-			Cout() << "\n" << t_("Command argument list is empty");
+			ConsoleOut() << "\n" << t_("Command argument list is empty");
 			ShowHelp(md);
 		} else {
 			for (int i = 0; i < command.size(); i++) {
@@ -1593,16 +1791,351 @@ void ConsoleMain(const Upp::Vector<String>& command, bool gui) {
 					if (!FileExists(file)) 
 						throw Exc(Format(t_("File '%s' not found"), file)); 
 					
-					md.Load(file, [&](String str, int) {Cout() << str; return true;}, true);
-					Cout() << "\n" << Format(t_("File '%s' loaded"), file);
+					if (cache)
+						cache->Load(md, file);
+					else
+						md.Load(file, [&](String str, int) {ConsoleOut() << str; return true;}, true);
+					ConsoleOut() << "\n" << Format(t_("File '%s' loaded"), file);
 				} else if (command[i] == "-r" || command[i] == "--report") {
 					if (md.hydros.IsEmpty()) 
 						throw Exc(t_("No file loaded"));
 					int lastId = md.hydros.size() - 1;
 					md.hydros[lastId].hd().Report();
+				} else if (command[i] == "-he" || command[i] == "--heal") {
+					if (md.hydros.IsEmpty()) 
+						throw Exc(t_("No file loaded"));
+					int lastId = md.hydros.size() - 1;
+					Hydro &hydro = md.hydros[lastId].hd();
+					if (!hydro.Heal([&](String str, int) {ConsoleOut() << "\n" << str; return true;}))
+						throw Exc(hydro.GetLastError());
+					ConsoleOut() << "\n" << Format(t_("Model '%s' healed"), hydro.name);
+				} else if (command[i] == "-rw" || command[i] == "--resample") {
+					if (md.hydros.IsEmpty()) 
+						throw Exc(t_("No file loaded"));
+					double fromW = GetDoubleArg(command, ++i, "--resample");
+					double toW = GetDoubleArg(command, ++i, "--resample");
+					i++;
+					CheckNumArgs(command, i, "--resample");
+					int num = ScanInt(command[i]);
+					if (IsNull(num) || num < 2 || fromW < 0 || toW <= fromW)
+						throw Exc(Format(t_("Wrong argument '%s'"), command[i]));
+					bool cubic = false, qtf = false;
+					if (i+1 < command.size() && (command[i+1] == "cubic" || command[i+1] == "qtf")) {
+						i++;
+						cubic = command[i] == "cubic";
+						qtf = command[i] == "qtf";
+					}
+					int lastId = md.hydros.size() - 1;
+					Hydro &hydro = md.hydros[lastId].hd();
+					Upp::Vector<double> nw;
+					LinSpaced(nw, num, fromW, toW);
+					if (qtf) {
+						if (hydro.qtfw.IsEmpty())
+							throw Exc(t_("No QTF loaded"));
+						hydro.ResampleQTFW(nw);
+					} else
+						hydro.ResampleW(nw, cubic);
+					ConsoleOut() << "\n" << Format(t_("Model '%s' resampled to %d frequencies"), hydro.name, num);
+				} else if (command[i] == "-rh" || command[i] == "--resamplehead") {
+					if (md.hydros.IsEmpty()) 
+						throw Exc(t_("No file loaded"));
+					double fromH = GetDoubleArg(command, ++i, "--resamplehead");
+					double toH = GetDoubleArg(command, ++i, "--resamplehead");
+					i++;
+					CheckNumArgs(command, i, "--resamplehead");
+					int num = ScanInt(command[i]);
+					if (IsNull(num) || num < 1 || (num > 1 && toH <= fromH))
+						throw Exc(Format(t_("Wrong argument '%s'"), command[i]));
+					int lastId = md.hydros.size() - 1;
+					Hydro &hydro = md.hydros[lastId].hd();
+					Upp::Vector<double> nhead;
+					if (num == 1)
+						nhead << fromH;
+					else
+						LinSpaced(nhead, num, fromH, toH);
+					hydro.ResampleHead(nhead);
+					ConsoleOut() << "\n" << Format(t_("Model '%s' resampled to %d headings"), hydro.name, num);
+				} else if (command[i] == "-ss" || command[i] == "--statespace") {
+					if (md.hydros.IsEmpty()) 
+						throw Exc(t_("No file loaded"));
+					i++;
+					CheckNumArgs(command, i, "--statespace");
+					int maxOrder = ScanInt(command[i]);
+					if (IsNull(maxOrder))
+						throw Exc(Format(t_("Wrong argument '%s'"), command[i]));
+					double maxError = GetDoubleArg(command, ++i, "--statespace");
+					double fromW = Null, toW = Null;
+					if (i+1 < command.size() && !IsNull(ScanDouble(command[i+1]))) {
+						fromW = GetDoubleArg(command, ++i, "--statespace");
+						toW = GetDoubleArg(command, ++i, "--statespace");
+					}
+					int lastId = md.hydros.size() - 1;
+					Hydro &hydro = md.hydros[lastId].hd();
+					if (!hydro.GetStateSpace(fromW, toW, maxOrder, maxError, [&](String str, int) {ConsoleOut() << "\n" << str; return true;}))
+						throw Exc(hydro.GetLastError());
+					ConsoleOut() << "\n" << Format(t_("State space of model '%s' obtained"), hydro.name);
+				} else if (command[i] == "-ra" || command[i] == "--rao") {
+					if (md.hydros.IsEmpty()) 
+						throw Exc(t_("No file loaded"));
+					int lastId = md.hydros.size() - 1;
+					Hydro &hydro = md.hydros[lastId].hd();
+					Eigen::MatrixXd M, Dlin, Dquad, Cmoor;
+					GetDynMatricesArgs(command, i, "--rao", M, Dlin, Dquad, Cmoor);
+					if (!hydro.GetRAO(M, Dlin, Dquad, Cmoor, [&](String str, int) {ConsoleOut() << "\n" << str; return true;}))
+						throw Exc(hydro.GetLastError());
+					ConsoleOut() << "\n" << Format(t_("RAO of model '%s' obtained"), hydro.name);
+				} else if (command[i] == "-rs" || command[i] == "--response") {
+					if (md.hydros.IsEmpty()) 
+						throw Exc(t_("No file loaded"));
+					i++;
+					CheckNumArgs(command, i, "--response");
+					String fileSea = command[i];
+					i++;
+					CheckNumArgs(command, i, "--response");
+					String fileRes = command[i];
+					
+					int lastId = md.hydros.size() - 1;
+					Hydro &hydro = md.hydros[lastId].hd();
+					Upp::Vector<Hydro::SeaState> seaStates;
+					Upp::Array<Hydro::ResponseStats> stats;
+					Hydro::LoadSeaStates(fileSea, seaStates);
+					if (!hydro.GetResponseStats(seaStates, stats))
+						throw Exc(hydro.GetLastError());
+					hydro.SaveResponseStats(fileRes, seaStates, stats);
+					ConsoleOut() << "\n" << Format(t_("Response of %d sea states saved in '%s'"), seaStates.size(), fileRes);
+				} else if (command[i] == "-ts" || command[i] == "--timeseries") {
+					if (md.hydros.IsEmpty()) 
+						throw Exc(t_("No file loaded"));
+					i++;
+					CheckNumArgs(command, i, "--timeseries");
+					String fileSea = command[i];
+					double duration = GetDoubleArg(command, ++i, "--timeseries");
+					double dt = GetDoubleArg(command, ++i, "--timeseries");
+					i++;
+					CheckNumArgs(command, i, "--timeseries");
+					String fileRes = command[i];
+					if (duration <= 0 || dt <= 0 || dt > duration)
+						throw Exc(t_("Wrong time step or duration"));
+					bool slowDrift = false, newman = false;
+					if (i+1 < command.size() && (command[i+1] == "newman" || command[i+1] == "full")) {
+						i++;
+						slowDrift = true;
+						newman = command[i] == "newman";
+					}
+					
+					int lastId = md.hydros.size() - 1;
+					Hydro &hydro = md.hydros[lastId].hd();
+					Upp::Vector<Hydro::SeaState> seaStates;
+					Hydro::LoadSeaStates(fileSea, seaStates);
+					
+					// Long series are got in segments, and saved as they are got
+					const int maxSegSamples = 65536;
+					double segLength = min(duration + dt, maxSegSamples*dt);
+					for (int is = 0; is < seaStates.size(); ++is) {
+						const Hydro::SeaState &sea = seaStates[is];
+						String fileCase = GetCaseFileName(fileRes, is, seaStates.size());
+						FileOut out(fileCase);
+						if (!out.IsOpen())
+							throw Exc(Format(t_("Impossible to open file '%s'"), fileCase));
+						Hydro::SaveForceTimeSeriesHeader(out, hydro.Nb, slowDrift);
+						if (!hydro.GetFexTimeSeries(sea, Upp::Vector<double>(), Upp::Vector<double>(), dt, duration, segLength, is, 
+								[&](double t0, const Eigen::MatrixXd &chunk) {
+									Hydro::SaveForceTimeSeries(out, t0, dt, chunk);
+								}, slowDrift ? 6*hydro.Nb : 0, 
+								[&](const Hydro::WaveComponents &waves, Eigen::MatrixXd &fsd)->bool {
+									double segDuration = (2*waves.amp.size() - 0.5)*dt;		// The whole segment
+									fsd.resize(2*waves.amp.size(), 6*hydro.Nb);
+									for (int ib = 0; ib < hydro.Nb; ++ib) {
+										Eigen::MatrixXd f;
+										if (!hydro.GetSlowDriftTimeSeries(waves, sea.head, ib, dt, segDuration, newman, Null, f))
+											return false;
+										fsd.middleCols(6*ib, 6) = f;
+									}
+									return true;
+								}))
+							throw Exc(hydro.GetLastError());
+						out.Close();
+						if (out.IsError())
+							throw Exc(Format(t_("Problem saving '%s'"), fileCase));
+					}
+					ConsoleOut() << "\n" << Format(t_("Force series of %d sea states saved in '%s'"), seaStates.size(), fileRes);
+				} else if (command[i] == "-td" || command[i] == "--timedomain") {
+					if (md.hydros.IsEmpty()) 
+						throw Exc(t_("No file loaded"));
+					i++;
+					CheckNumArgs(command, i, "--timedomain");
+					String fileSea = command[i];
+					double duration = GetDoubleArg(command, ++i, "--timedomain");
+					double dt = GetDoubleArg(command, ++i, "--timedomain");
+					i++;
+					CheckNumArgs(command, i, "--timedomain");
+					String fileRes = command[i];
+					if (duration <= 0 || dt <= 0 || dt > duration)
+						throw Exc(t_("Wrong time step or duration"));
+					Eigen::MatrixXd M, Dlin, Dquad, Cmoor;
+					GetDynMatricesArgs(command, i, "--timedomain", M, Dlin, Dquad, Cmoor);
+					bool stateSpace = false;
+					if (i+1 < command.size() && command[i+1] == "ss") {
+						i++;
+						stateSpace = true;
+					}
+					
+					int lastId = md.hydros.size() - 1;
+					Hydro &hydro = md.hydros[lastId].hd();
+					if (M.size() == 0 && !hydro.IsLoadedM())
+						throw Exc(t_("Mass matrix is required. Set it with 'M <matrix file>'"));
+					Upp::Vector<Hydro::SeaState> seaStates;
+					Hydro::LoadSeaStates(fileSea, seaStates);
+					
+					Eigen::Index numT = Eigen::Index(duration/dt) + 1;
+					Upp::Array<Hydro::TimeDomainCase> cases(seaStates.size());
+					for (int is = 0; is < seaStates.size(); ++is) {
+						Eigen::MatrixXd &f = cases[is].f;
+						f.setZero(numT, 6*hydro.Nb);
+						if (!hydro.GetFexTimeSeries(seaStates[is], Upp::Vector<double>(), Upp::Vector<double>(), dt, duration, duration, is, 
+								[&](double t0, const Eigen::MatrixXd &chunk) {
+									Eigen::Index it = Eigen::Index(t0/dt + 0.5);
+									f.middleRows(it, min(chunk.rows(), numT - it)) = chunk.topRows(min(chunk.rows(), numT - it));
+								}))
+							throw Exc(hydro.GetLastError());
+					}
+					if (!hydro.Cummins(M, Dlin, Dquad, Cmoor, dt, duration, Null, stateSpace, cases))
+						throw Exc(hydro.GetLastError());
+					for (int is = 0; is < cases.size(); ++is)
+						Hydro::SaveTimeDomainOut(GetCaseFileName(fileRes, is, cases.size()), cases[is], dt);
+					ConsoleOut() << "\n" << Format(t_("Time domain simulation of %d sea states saved in '%s'"), cases.size(), fileRes);
+				} else if (command[i] == "-gz" || command[i] == "--gz") {
+					double vals[5];
+					i++;
+					CheckNumArgs(command, i, "--gz");
+					String fileMesh = command[i];
+					for (int iv = 0; iv < 5; ++iv) {
+						i++;
+						CheckNumArgs(command, i, "--gz");
+						vals[iv] = ScanDouble(command[i]);
+						if (IsNull(vals[iv]))
+							throw Exc(Format(t_("Wrong argument '%s'"), command[i]));
+					}
+					i++;
+					CheckNumArgs(command, i, "--gz");
+					String fileRes = command[i];
+					double angles[3] = {90, 5, 360};
+					for (int ia = 0; ia < 3 && i+1 < command.size() && !IsNull(ScanDouble(command[i+1])); ++ia) {
+						angles[ia] = ScanDouble(command[++i]);
+						if (angles[ia] <= 0)
+							throw Exc(Format(t_("Wrong argument '%s'"), command[i]));
+					}
+					
+					MeshData data;
+					String error = data.Load(fileMesh);
+					if (!error.IsEmpty())
+						throw Exc(Format(t_("Problem loading '%s'") + S("\n%s"), fileMesh, error));
+					data.mass = vals[0];
+					data.cg = Point3D(vals[1], vals[2], vals[3]);
+					data.AfterLoad(md.rho, md.g, false);
+					int iter = data.Equilibrium(md.rho, md.g);
+					ConsoleOut() << "\n" << Format(t_("Equilibrium found in %d iterations. cg is (%f, %f, %f)"), 
+											iter, data.cg.x, data.cg.y, data.cg.z);
+					
+					Upp::Vector<double> headings, heels;
+					for (double h = 0; h < 360 - 1E-6; h += angles[2])
+						headings << h;
+					for (double h = 0; h <= angles[0] + 1E-6; h += angles[1])
+						heels << h;
+					Upp::Array<MeshData::GZCase> cases;
+					data.GetGZ(headings, heels, md.rho, md.g, cases);
+					MeshData::SaveGZ(fileRes, cases);
+					ConsoleOut() << "\n" << Format(t_("GZ of %d cases saved in '%s'"), cases.size(), fileRes);
+				} else if (command[i] == "-t" || command[i] == "--threads") {
+					i++;
+					CheckNumArgs(command, i, "--threads");
+					numThreads = ScanInt(command[i]);
+					if (IsNull(numThreads) || numThreads <= 0)
+						throw Exc(Format(t_("Wrong argument '%s'"), command[i]));
+				} else if (command[i] == "-b" || command[i] == "--batch") {
+					i++;
+					CheckNumArgs(command, i, "--batch");
+					String input = command[i];
+					i++;
+					CheckNumArgs(command, i, "--batch");
+					String ext = command[i];
+					String outFolder;
+					if (i+1 < command.size() && !command[i+1].StartsWith("-")) {
+						i++;
+						outFolder = command[i];
+					}
+					int numErrors = md.BatchConvert(input, ext, outFolder, numThreads);
+					if (numErrors > 0)
+						ConsoleOut() << "\n" << Format(t_("Batch conversion finished with %d errors"), numErrors);
+					else
+						ConsoleOut() << "\n" << t_("Batch conversion finished");
+				} else if (command[i] == "-mc" || command[i] == "--meshcache") {
+					i++;
+					CheckNumArgs(command, i, "--meshcache");
+					String folder = command[i];
+					bool clean = false;
+					if (i+1 < command.size() && command[i+1] == "clean") {
+						i++;
+						clean = true;
+					}
+					int numErrors = md.WarmMeshCache(folder, clean, numThreads);
+					if (numErrors > 0)
+						ConsoleOut() << "\n" << Format(t_("Mesh cache finished with %d errors"), numErrors);
+					else
+						ConsoleOut() << "\n" << t_("Mesh cache finished");
+				} else if (command[i] == "-mcs" || command[i] == "--meshcachesize") {
+					i++;
+					CheckNumArgs(command, i, "--meshcachesize");
+					int size = ScanInt(command[i]);
+					if (IsNull(size) || size < 0)
+						throw Exc(Format(t_("Wrong argument '%s'"), command[i]));
+					md.meshCacheSize = size;
+					MeshData::SetCacheMaxSize(int64(size) << 20);
+					if (i+1 < command.size() && command[i+1] == "save") {
+						i++;
+						if (!md.StoreSerializeJson())
+							throw Exc(t_("Impossible to save the configuration"));
+					}
+					if (size == 0)
+						ConsoleOut() << "\n" << t_("Mesh cache disabled");
+					else
+						ConsoleOut() << "\n" << Format(t_("Mesh cache size set to %d MB"), size);
+				} else if (command[i] == "-mcc" || command[i] == "--meshcacheclear") {
+					MeshData::ClearCache();
+					ConsoleOut() << "\n" << t_("Mesh cache cleared");
+				} else if (command[i] == "--bench") {		// Not in help. Times the mesh processing, and the state space and slow drift of the last loaded model
+					int maxPanels = 1000000;
+					if (i+1 < command.size() && !IsNull(ScanInt(command[i+1]))) 
+						maxPanels = ScanInt(command[++i]);
+					RunBenchmark(md, maxPanels);
+				} else if (command[i] == "-pf" || command[i] == "--profile") {
+					if (cache)				// Timings are process wide, so they would mix the server requests
+						throw Exc(t_("Profile is not available in the server"));
+					Profiler::Clear();
+					Profiler::Enable();
+					if (i+1 < command.size() && !command[i+1].StartsWith("-")) 
+						traceFile = command[++i];
+				} else if (command[i] == "-sv" || command[i] == "--server") {
+					if (cache)
+						throw Exc(t_("Server is already running"));
+					int port = HydroCache::defaultPort;
+					if (i+1 < command.size() && !IsNull(ScanInt(command[i+1]))) 
+						port = ScanInt(command[++i]);
+					RunServer(md, port);
+				} else if (command[i] == "-ct" || command[i] == "--client") {
+					if (cache)
+						throw Exc(t_("Client cannot be called from the server"));
+					int port = HydroCache::defaultPort;
+					if (i+1 < command.size() && !IsNull(ScanInt(command[i+1]))) 
+						port = ScanInt(command[++i]);
+					Upp::Vector<String> rest;
+					for (i++; i < command.size(); ++i)
+						rest << command[i];
+					RunClient(rest, port);
+					break;
 				} else if (command[i] == "-cl" || command[i] == "--clear") {
 					md.hydros.Clear();
-					Cout() << "\n" << t_("Series cleared");
+					ConsoleOut() << "\n" << t_("Series cleared");
 				} else if (command[i] == "-c" || command[i] == "--convert") {
 					if (md.hydros.IsEmpty()) 
 						throw Exc(t_("No file loaded"));
@@ -1612,7 +2145,7 @@ void ConsoleMain(const Upp::Vector<String>& command, bool gui) {
 					String file = command[i];
 					
 					md.hydros[0].hd().SaveAs(file);
-					Cout() << "\n" << Format(t_("File '%s' converted"), file);
+					ConsoleOut() << "\n" << Format(t_("File '%s' converted"), file);
 				} else if (command[i] == "-p" || command[i] == "--params") {
 					i++;
 					CheckNumArgs(command, i, "--params");
@@ -1671,13 +2204,25 @@ void ConsoleMain(const Upp::Vector<String>& command, bool gui) {
 	} catch(...) {
 		errorStr = t_("Unknown error");
 	}	
+	if (!cache && Profiler::IsEnabled()) {		// Server requests leave the server profile running
+		Profiler::Enable(false);
+		ConsoleOut() << "\n\n" << t_("Profile") << Profiler::GetSummary();
+		if (!traceFile.IsEmpty()) {
+			try {
+				Profiler::SaveChromeTrace(traceFile);
+				ConsoleOut() << "\n" << Format(t_("Trace saved in '%s'"), traceFile);
+			} catch (Exc e) {
+				errorStr = e;
+			}
+		}
+	}
 	if (!errorStr.IsEmpty()) {
-		Cerr() << Format("\n%s: %s", t_("Error"), errorStr);
-		Cerr() << S("\n\n") + t_("In case of doubt try option -h or --help");
+		Stream &err = cache ? ConsoleOut() : Cerr();
+		err << Format("\n%s: %s", t_("Error"), errorStr);
+		err << S("\n\n") + t_("In case of doubt try option -h or --help");
 		if (gui)
-			Cerr() << S("\n") + t_("or just call command line without arguments to open GUI window");
+			err << S("\n") + t_("or just call command line without arguments to open GUI window");
 	}
-	Cout() << "\n";
 }
 
 void SetBuildInfo(String &str) {
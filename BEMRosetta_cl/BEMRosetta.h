@@ -7,10 +7,17 @@
 
 using namespace Upp;
 
+#include "profile.h"
+
 
 class BEMData;
 
+class HydroCache;
+
 void ConsoleMain(const Upp::Vector<String>& command, bool gui);
+void ConsoleProcess(BEMData &md, const Upp::Vector<String>& command, bool gui, HydroCache *cache);
+Stream &ConsoleOut();
+Stream *SetConsoleOut(Stream *out);
 void SetBuildInfo(String &str);
 
 
@@ -133,6 +140,25 @@ public:
   	typedef struct Forces RAO;
    
    	RAO rao;
+   	
+   	struct SeaState : Moveable<SeaState> {
+   		double Hs = Null, Tp = Null;		// m, s
+   		double gamma = 1;					// JONSWAP peak enhancement factor. 1 for Pierson-Moskowitz
+   		double head = 0;					// deg
+   		double duration = 10800;			// s	Duration for the most probable maximum
+   	};
+   	struct WaveComponents {
+   		double dw = Null;					// rad/s	Component k has frequency k·dw
+   		Eigen::VectorXd amp, phi;			// [nk]		m, rad
+   	};
+   	struct ResponseStats {
+   		Upp::Vector<double> m0, sig, mpm;	// [6*Nb]	Zero order moment, significant amplitude and most probable maximum
+   	};
+   	struct TimeDomainCase {
+   		Eigen::MatrixXd f;					// (numT, 6*Nb)	Excitation force. May be empty
+   		Eigen::VectorXd x0, v0;				// [6*Nb]		Initial position and velocity. May be empty
+   		Eigen::MatrixXd x, v;				// (numT, 6*Nb)	Results
+   	};
     
     String description;
 
@@ -144,6 +170,10 @@ public:
 		Eigen::VectorXd ssFrequencies, ssFreqRange, ssFrequencies_index;
 		double ssMAE = Null;
 		
+		Eigen::VectorXd tfsW;				// Data TFS was got from, so it is not recalculated
+		Eigen::MatrixXd tfsA;
+		Eigen::VectorXd tfsB, tfsC;
+		
 		void GetTFS(const Upp::Vector<double> &w);
 		
 		void Jsonize(JsonIO &json) {
@@ -349,6 +379,7 @@ public:
 	void SetId(int _id)			{id = _id;}
 	int GetId()	const			{return id;}
 	
+	void Copy(const Hydro &hyd);
 	void Jsonize(JsonIO &json);
 	
 private:
@@ -361,7 +392,7 @@ private:
 	void Symmetrize_Forces_Each0(const Forces &f, Forces &newf, const Upp::Vector<double> &newHead, double h, int ih, int idb);
 	void Symmetrize_ForcesEach(const Forces &f, Forces &newf, const Upp::Vector<double> &newHead, int newNh, bool xAxis);
 	int id;
-	static int idCount;
+	static std::atomic<int> idCount;
 	 
 	static void GetOldAB(const Upp::Array<Eigen::MatrixXd> &oldAB, Upp::Array<Upp::Array<Eigen::VectorXd>> &AB);
 	static void SetOldAB(Upp::Array<Eigen::MatrixXd> &oldAB, const Upp::Array<Upp::Array<Eigen::VectorXd>> &AB);
@@ -460,6 +491,7 @@ public:
 	bool IsLoadedAw0()	 const {return Aw0.size() > 0;}
 	bool IsLoadedB() 	 const {return !B.IsEmpty();}
 	bool IsLoadedC()	 const {return !C.IsEmpty() && C[0].size() > 0 && !IsNull(C[0](0, 0));}
+	bool IsLoadedM()	 const {return !M.IsEmpty() && M[0].size() > 0 && !IsNull(M[0](0, 0));}
 	bool IsLoadedFex() 	 const {return !ex.ma.IsEmpty();}
 	bool IsLoadedFsc() 	 const {return !sc.ma.IsEmpty();}
 	bool IsLoadedFfk() 	 const {return !fk.ma.IsEmpty();}
@@ -497,6 +529,35 @@ public:
 	void GetAinf();
 	void GetAinfw();
 	
+	bool Heal(Function <bool(String, int)> Status);
+	void GetTFS(const Upp::Vector<double> &w);
+	bool GetStateSpace(double fromW, double toW, int maxOrder, double maxError, Function <bool(String, int)> Status);
+	bool GetRAO(const Eigen::MatrixXd &M, const Eigen::MatrixXd &Dlin, const Eigen::MatrixXd &Dquad, const Eigen::MatrixXd &Cmoor,
+				Function <bool(String, int)> Status);
+	bool GetMassMatrix(const Eigen::MatrixXd &M, Eigen::MatrixXd &mass);
+	bool CheckDynMatrices(const Eigen::MatrixXd &mass, const Eigen::MatrixXd &Dlin, const Eigen::MatrixXd &Dquad, const Eigen::MatrixXd &Cmoor);
+	bool Cummins(const Eigen::MatrixXd &M, const Eigen::MatrixXd &Dlin, const Eigen::MatrixXd &Dquad, const Eigen::MatrixXd &Cmoor,
+				double dt, double duration, double memoryT, bool stateSpace, Upp::Array<TimeDomainCase> &cases);
+	static void SaveTimeDomainOut(String fileName, const TimeDomainCase &cs, double dt);
+	void ResampleW(const Upp::Vector<double> &nw, bool cubic = false);
+	void ResampleQTFW(const Upp::Vector<double> &nqw);
+	void ResampleHead(const Upp::Vector<double> &nhead);
+	
+	bool GetResponseStats(const Upp::Vector<SeaState> &seaStates, Upp::Array<ResponseStats> &stats, int numW = 200);
+	static void LoadSeaStates(String fileName, Upp::Vector<SeaState> &seaStates);
+	static void LoadMatrix(String fileName, Eigen::MatrixXd &m);
+	
+	void GetFexOnGrid(double hd, const Eigen::VectorXd &wk, Eigen::MatrixXcd &fex) const;
+	bool GetFexTimeSeries(const SeaState &sea, const Upp::Vector<double> &heads, const Upp::Vector<double> &weights,
+				double dt, double duration, double segLength, unsigned seed,
+				Function <void(double, const Eigen::MatrixXd &)> WhenChunk, 
+				int numExtra = 0, Function <bool(const WaveComponents &, Eigen::MatrixXd &)> WhenSegment = Null);
+	bool GetSlowDriftTimeSeries(const WaveComponents &waves, double head, int ib, double dt, double duration, 
+				bool newman, double maxDiffW, Eigen::MatrixXd &f);
+	static void SaveForceTimeSeriesHeader(Stream &out, int Nb, bool slowDrift);
+	static void SaveForceTimeSeries(Stream &out, double t0, double dt, const Eigen::MatrixXd &f);
+	void SaveResponseStats(String fileName, const Upp::Vector<SeaState> &seaStates, const Upp::Array<ResponseStats> &stats) const;
+	
 	void Join(const Upp::Vector<Hydro *> &hydrosp);
 	
 	String S_g()	const {return IsNull(g)   ? S("unknown") : Format("%.3f", g);}
@@ -542,6 +603,91 @@ public:
 	HydroData hd;	
 };
 
+// Joins coincident nodes using a hash of the grid cells of tolerance size, so each node is only compared 
+// with the nodes in the neighbour cells. With zero tolerance, only nodes with the same coordinates are joined
+class NodeWelder {
+public:
+	NodeWelder(Upp::Vector<Point3D> &nodes, double tolerance = 0);
+	int Add(const Point3D &p);
+	
+	static void Weld(Upp::Vector<Panel> &panels, Upp::Vector<Point3D> &nodes, double tolerance = defaultTolerance);
+	
+	static constexpr double defaultTolerance = 1E-6;	// m
+
+private:
+	Upp::Vector<Point3D> &nodes;
+	Index<hash_t> keys;				// [nodes.size()] Cell of each node
+	double tol;
+	
+	hash_t Key(const Point3D &p) const;
+	static hash_t Key(int64 ix, int64 iy, int64 iz);
+};
+
+// Structure of arrays copy of a Surface, for the kernels that loop over all nodes or panels.
+// Triangles have id[3] == id[0], as in Panel
+class MeshSoA {
+public:
+	MeshSoA() {}
+	MeshSoA(const Surface &surf)		{Load(surf);}
+
+	void Load(const Surface &surf)		{Load(surf.nodes, surf.panels);}
+	void Load(const Upp::Vector<Point3D> &nodes, const Upp::Vector<Panel> &panels);
+	void Save(Surface &surf) const;
+
+	int GetNodeCount() const			{return int(x.size());}
+	int GetPanelCount() const			{return int(id[0].size());}
+	Point3D GetNode(int i) const		{return Point3D(x(i), y(i), z(i));}
+	Point3D GetPanelNode(int ip, int j) const	{return GetNode(id[j](ip));}
+	bool IsTriangle(int ip) const		{return id[3](ip) == id[0](ip);}
+
+	void GetPanelNodes(int from, int to, int j, Eigen::ArrayXd &px, Eigen::ArrayXd &py, Eigen::ArrayXd &pz) const;
+	void GetPanelParams();
+
+	void Translate(double dx, double dy, double dz);
+	void Transform(const Eigen::Matrix3d &R, const Eigen::Vector3d &t);
+	void Mirror(int axis);
+
+	Eigen::ArrayXd x, y, z;					// Nodes
+	Eigen::ArrayXi id[4];					// Panel node ids
+	Eigen::ArrayXd nx, ny, nz, area;		// Panel unit normal and area. Empty until GetPanelParams()
+	Eigen::ArrayXd cx, cy, cz;				// Panel centroid
+};
+
+// Bounding volume hierarchy of the panels of a Surface, for plane clipping, picking and proximity queries.
+// It is built once and refit when the nodes are moved without changing the panels
+class PanelBVH {
+public:
+	void Build(const Surface &surf);
+	void Refit(const Surface &surf);
+	void Clear()				{nodes.Clear(); ids.Clear();}
+	bool IsEmpty() const		{return nodes.IsEmpty();}
+	
+	void GetCrossingPlane(const Surface &surf, const Eigen::Vector3d &normal, double d, Upp::Vector<int> &panels, 
+						  Upp::Vector<int> *below = nullptr) const;
+	int Raycast(const Surface &surf, const Point3D &from, const Point3D &dir, double &dist) const;
+	int GetNearest(const Surface &surf, const Point3D &p, double &dist) const;
+	void GetSelfIntersections(const Surface &surf, Upp::Vector<Tuple<int, int>> &pairs) const;
+	
+private:
+	struct Node : Moveable<Node> {
+		double mn[3], mx[3];	// Box
+		int from, to;			// Range in ids
+		int right = -1;			// Left child is the next node. -1 in leaves
+		
+		bool IsLeaf() const		{return right < 0;}
+		void Join(const Node &node);
+		double Distance2(const Eigen::Vector3d &p) const;
+		bool Overlaps(const Node &node) const;
+		double Raycast(const Eigen::Vector3d &from, const Eigen::Vector3d &invDir, double maxDist) const;
+	};
+	Upp::Vector<Node> nodes;
+	Upp::Vector<int> ids;		// Panels sorted so each node has a range
+	
+	static constexpr int leafSize = 4;
+	
+	int BuildNode(const Upp::Vector<Point3D> &centroids, int from, int to);
+};
+
 class MeshData {
 public:
 	enum MESH_FMT {WAMIT_GDF, WAMIT_DAT, NEMOH_DAT, NEMOH_PRE, AQWA_DAT, HAMS_PNL, STL_BIN, STL_TXT, EDIT, UNKNOWN};
@@ -570,6 +716,7 @@ public:
 	void SetCode(MESH_FMT _code){code = _code;}
 	MESH_FMT GetCode()			{return code;}
 	int GetId()	const			{return id;}
+	int GetVersion() const		{return version;}	// Changes when the geometry changes
 
 	String Load(String fileName, double rho, double g, bool cleanPanels);
 	String Load(String fileName, double rho, double g, bool cleanPanels, bool &y0z, bool &x0z);
@@ -580,13 +727,90 @@ public:
 	String LoadGdfWamit(String fileName, bool &y0z, bool &x0z);
 	String LoadDatAQWA(String fileName);
 	String LoadPnlHAMS(String fileName, bool &y0z, bool &x0z);
+	String LoadStlBin(String fileName);
+	
+	static MESH_FMT GetFileFormat(String fileName);
+	
+	static String GetCacheFolder()	{return AppendFileNameX(GetAppDataFolder(), "BEMRosetta", "MeshCache");}
+	static String GetCacheFileName(String fileName);
+	static void SetCacheMaxSize(int64 size)	{cacheMaxSize = size;}
+	static int64 GetCacheMaxSize()			{return cacheMaxSize;}
+	static void ClearCache();
 	
 	String Heal(bool basic, Function <void(String, int pos)> Status);
 	void Orient();
 	void Join(const Surface &orig, double rho, double g);
 	void Image(int axis);
+	
+	static void Decimate(const Upp::Vector<Point3D> &nodes, const Upp::Vector<Panel> &panels, int numPanels, Surface &dest);
+	static Upp::Vector<Upp::Vector<int>> GetPanelSets(const Surface &surf);
+	static void ExtractPanels(const Surface &orig, const Upp::Vector<int> &ids, Surface &dest);
 		
 	void AfterLoad(double rho, double g, bool onlyCG);
+	void Translate(double x, double y, double z, double rho, double g);
+	void Rotate(double ax, double ay, double az, double cx, double cy, double cz, double rho, double g);
+
+	// Surface, volume and underwater integrals, got in a single pass over the panels
+	// and updated incrementally when the mesh is moved as a rigid body
+	struct Hydrostatics {
+		// Area and ∫f·n dS for f = 1, x, y, z, x², y², z², xy, xz, yz
+		struct Moments {
+			double area = 0;
+			double m[10][3] = {};
+			
+			void Add(const Moments &mom, double sign = 1);
+			void AddTriangle(const Point3D &a, const Point3D &b, const Point3D &c, double sign = 1);
+			void AddTriangleUnder(const Point3D &a, const Point3D &b, const Point3D &c);
+			void AddPanel(const MeshSoA &soa, int ip, double sign = 1);
+			void AddPanelUnder(const MeshSoA &soa, int ip);
+			void Transform(const Eigen::Matrix3d &R, const Eigen::Vector3d &t);
+			
+			static void AddTriangles(const Eigen::ArrayXd a[3], const Eigen::ArrayXd b[3], const Eigen::ArrayXd c[3],
+									const Eigen::ArrayXd &w, Moments &full, Moments &part);
+		};
+		
+		double surface = 0, volumex = 0, volumey = 0, volumez = 0;
+		double underSurface = 0, underVolumex = 0, underVolumey = 0, underVolumez = 0;
+		double momx = 0, momy = 0, momz = 0;						// ∫x dV, ∫y dV, ∫z dV underwater
+		double wpArea = 0, wpx = 0, wpy = 0, wpxx = 0, wpyy = 0, wpxy = 0;	// Water plane moments
+		
+		void Get(const MeshSoA &soa);
+		void Get(const Surface &surf)	{Get(MeshSoA(surf));}
+		void Move(const MeshSoA &soa, const Eigen::Matrix3d &R, const Eigen::Vector3d &t);
+		void Move(const Surface &surf, const Eigen::Matrix3d &R, const Eigen::Vector3d &t)	{Move(MeshSoA(surf), R, t);}
+		
+		double GetVolume() const		{return (volumex + volumey + volumez)/3;}
+		double GetUnderVolume() const	{return (underVolumex + underVolumey + underVolumez)/3;}
+		Point3D GetCb() const;
+		void GetC(Eigen::MatrixXd &C, double rho, double g, const Point3D &cg, double mass) const;
+		
+		void Serialize(Stream &s);
+	
+	private:
+		Moments full, wet;				// wet has only the fully submerged panels
+		Upp::Vector<int8> side;			// Per panel: -1 submerged, 0 crossing the water line, 1 dry
+		int numMoves = 0;				// Incremental moves since the last full integration
+		static const int maxMoves = 32;
+		
+		void Update(const Moments &cut);
+	};
+	Hydrostatics hs;
+	
+	// Point of the stability curves. heel is around an horizontal axis with direction heading [deg]
+	struct GZCase {
+		double heading, heel;
+		double heave = Null, gz = Null;	// Null if the displacement is not reached
+		Point3D cb;
+		Eigen::MatrixXd C;
+	};
+	int Equilibrium(double rho, double g, int maxIter = 50, double tolerance = 1E-8);
+	void GetGZ(const Upp::Vector<double> &headings, const Upp::Vector<double> &heels, double rho, double g,
+				Upp::Array<GZCase> &cases) const;
+	static void SaveGZ(String fileName, const Upp::Array<GZCase> &cases);
+	
+	const PanelBVH &GetBVH() const;
+	int PickPanel(const Point3D &from, const Point3D &dir, double &dist) const	{return GetBVH().Raycast(mesh, from, dir, dist);}
+	int GetNearestPanel(const Point3D &p, double &dist) const						{return GetBVH().GetNearest(mesh, p, dist);}
 
 	void SaveAs(String fileName, MESH_FMT type, double g, MESH_TYPE meshType, bool symX, bool symY);
 	static void SaveDatNemoh(String fileName, const Surface &surf, bool x0z);
@@ -616,7 +840,22 @@ public:
 private:
 	MESH_FMT code;
 	int id;
+	int version = 0;
 	static int idCount;
+	
+	mutable PanelBVH bvh;		// Built when first needed
+	mutable Mutex bvhMutex;
+	
+	void CutUnderwater();
+	void AfterMove(const Eigen::Matrix3d &R, const Eigen::Vector3d &t, double rho, double g);
+	void SetHydrostatics(double rho, double g);
+	
+	static int64 cacheMaxSize;	// bytes. 0 if the cache is disabled
+	
+	bool LoadCache(String fileName, bool cleanPanels, bool &y0z, bool &x0z);
+	void StoreCache(String fileName, bool cleanPanels, bool y0z, bool x0z);
+	static void TrimCache(int64 added);
+	void SerializeCache(Stream &s, bool &y0z, bool &x0z);
 };
 
 class Wamit : public HydroClass {
@@ -671,11 +910,23 @@ public:
 	void Get_Each(int ibody, int idf, int jdf, double from, double to, const Upp::Vector<double> &freqs, Function <bool(String, int)> Status, Function <void(String)> FOAMMMessage);
 	void Get(const Upp::Vector<int> &ibs, const Upp::Vector<int> &idfs, const Upp::Vector<int> &jdfs,
 		const Upp::Vector<double> &froms, const Upp::Vector<double> &tos, const Upp::Vector<Upp::Vector<double>> &freqs, 
-		Function <bool(String, int)> Status, Function <void(String)> FOAMMMessage);
+		Function <bool(String, int)> Status, Function <void(String)> FOAMMMessage, 
+		Function <bool(int)> IsCaseCancelled = Null, int numThreads = Null);
 	virtual ~Foamm() noexcept {}
 	
 protected:
 	bool Load_mat(String fileName, int ib, int jb, bool loadCoeff);
+	
+private:
+	struct FoammCase {
+		void Prepare(Foamm &foamm, int ibody, int idf, int jdf, double from, double to, const Upp::Vector<double> &freqs);
+		
+		int icase = -1;
+		int idf, jdf;
+		String folder, file;
+		LocalProcess process;
+		bool cancelled = false;
+	};
 };
 
 class Fast : public Wamit {
@@ -683,13 +934,13 @@ public:
 	Fast(BEMData &bem, Hydro *hydro = 0) : Wamit(bem, hydro), WaveNDir(Null), WaveDirRange(Null) {}
 	bool Load(String file, double g = 9.81);
 	void Save(String file, int qtfHeading = Null);
+	bool Load_SS(String fileName);	
+	void Save_SS(String fileName);
 	virtual ~Fast() noexcept {}
 	
 private:
 	bool Load_HydroDyn();	
 	void Save_HydroDyn(String fileName, bool force);
-	bool Load_SS(String fileName);	
-	void Save_SS(String fileName);
 	
 	String hydroFolder;
 	int WaveNDir;
@@ -881,6 +1132,7 @@ public:
 	bool experimental;
 	String foammPath;
 	String hamsPath;
+	int meshCacheSize = Null;	// MB. 0 disables the mesh cache
 	
 	void Load(String file, Function <bool(String, int pos)> Status, bool checkDuplicated);
 	HydroClass &Join(Upp::Vector<int> &ids, Function <bool(String, int)> Status);
@@ -904,12 +1156,17 @@ public:
 	void AddPolygonalPanel(double x, double y, double z, double size, Upp::Vector<Pointf> &vals);
 	void AddWaterSurface(int id, char c);
 	
+	Upp::Vector<String> GetBatchFiles(String input, String &baseFolder) const;
+	int BatchConvert(String input, String ext, String outFolder, int numThreads);
+	int WarmMeshCache(String folder, bool cleanPanels, int numThreads);
+	
 	bool LoadSerializeJson(bool &firstTime);
 	bool StoreSerializeJson();
 	bool ClearTempFiles();
 	static String GetTempFilesFolder() {return AppendFileNameX(GetAppDataFolder(), "BEMRosetta", "Temp");}
 	
 	const String bemFilesExt = ".1 .2 .3 .hst .4 .12s .12d .out .cal .tec .inf .ah1 .lis .qtf .mat .dat .bem";
+	const String meshFilesExt = ".gdf .dat .pnl .stl";
 	String bemFilesAst;
 	
 	void Jsonize(JsonIO &json) {
@@ -932,10 +1189,39 @@ public:
 			("nemohPathNew", nemohPathNew)
 			("foammPath", foammPath)
 			("hamsPath", hamsPath)
+			("meshCacheSize", meshCacheSize)
 		;
 	}
 };
 
+// Models loaded by the server, kept in memory with least recently used replacement.
+// They are identified by file name, size and modification time, so a changed file is loaded again
+class HydroCache {
+public:
+	enum {defaultPort = 45450};
+	
+	HydroCache(const BEMData &md, int maxModels = 20);
+	void Load(BEMData &md, String file);
+
+private:
+	struct Item {
+		String file;
+		int64 length;
+		Time time;
+		int64 lastUse;
+		std::shared_ptr<BEMData> md;		// Shared, so it can be copied while other request removes it
+	};
+	Upp::Array<Item> items;
+	Mutex mutex;
+	int64 useCount = 0;
+	int maxModels;
+	String config;
+};
+
+void RunServer(BEMData &md, int port);
+void RunClient(const Upp::Vector<String> &command, int port);
+void RunBenchmark(BEMData &md, int maxPanels);
+
 template <class T>
 bool OUTB(int id, T total) {
 	if (id < 0	|| id >= int(total))
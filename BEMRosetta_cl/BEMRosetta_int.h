@@ -3,4 +3,33 @@
 
 int IsTabSpace(int c);
 
+// Text file mapped in memory, read field by field without splitting it in line Strings
+class MeshScan {
+public:
+	bool Open(String fileName);
+	
+	bool IsEof() const		{return p >= end;}
+	bool IsEol();
+	String GetLine();
+	void NextLine();
+	bool FindLine(const char *text);
+	bool LineContains(const char *text) const;
+	
+	double GetDouble();
+	int GetInt();
+	
+	int64 GetFileSize() const	{return end - begin;}
+	String Str() const			{return Format(t_("Line %d"), line);}
+	
+	static String Peek(String fileName, int len = 4096);
+	
+private:
+	FileMapping map;
+	const char *begin = nullptr, *p = nullptr, *end = nullptr;
+	int line = 1;
+	
+	void SkipBlanks();
+	const char *GetField(char *buf, int len);
+};
+
 #endif
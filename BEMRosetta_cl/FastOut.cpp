@@ -271,6 +271,26 @@ bool FastOut::LoadOutb(String fileName) {
 	return true;
 }
 
+// Saves parameters in .out text format, so it can be loaded again by LoadOut()
+void FastOut::Save(String fileName) {
+	FileOut out(fileName);
+	if (!out.IsOpen())
+		throw Exc(Format("Impossible to open file '%s'", fileName));
+	
+	for (int c = 0; c < parameters.size(); ++c)
+		out << (c > 0 ? "\t" : "") << parameters[c];
+	out << "\n";
+	for (int c = 0; c < units.size(); ++c)
+		out << (c > 0 ? "\t" : "") << "(" << units[c] << ")";
+	out << "\n";
+	int num = dataOut.IsEmpty() ? 0 : dataOut[0].size();
+	for (int idt = 0; idt < num; ++idt) {
+		for (int c = 0; c < parameters.size(); ++c)
+			out << (c > 0 ? "\t" : "") << FormatDouble(dataOut[c][idt], 8, FD_EXP);
+		out << "\n";
+	}
+}
+
 void FastOut::AfterLoad() {
 	for (CalcParams &c : calcParams) {
 		if (!c.calc)
@@ -11,6 +11,7 @@ public:
 	static Vector<String> GetFilesToLoad(String path);
 	static String GetFileToLoad(String fileName);
 	int Load(String fileName);
+	void Save(String fileName);
 	
 	void Clear();
 	int GetCol(String param) const;
@@ -1,4 +1,5 @@
 #include "BEMRosetta.h"
+#include "BEMRosetta_int.h"
 
 int MeshData::idCount = 0;
 
@@ -17,21 +18,31 @@ String MeshData::Load(String file, double rho, double g, bool cleanPanels) {
 }
 	
 String MeshData::Load(String file, double rho, double g, bool cleanPanels, bool &y0z, bool &x0z) {
-	String ext = ToLower(GetFileExt(file));
-	String ret;
+	BEM_PROFILE("MeshData::Load");
 	y0z = x0z = false;
-	if (ext == ".dat") {
+	if (LoadCache(file, cleanPanels, y0z, x0z)) {
+		fileName = file;
+		name = InitCaps(GetFileTitle(file));
+		if (!IsNull(rho))
+			SetHydrostatics(rho, g);
+		return String();
+	}
+	
+	String ret;
+	MESH_FMT fmt = GetFileFormat(file);
+	if (fmt == NEMOH_DAT)
 		ret = LoadDatNemoh(file, x0z);
-		if (!ret.IsEmpty() && !ret.StartsWith(t_("Parsing error: "))) {
-			ret = LoadDatWamit(file);
-			if (!ret.IsEmpty() && !ret.StartsWith(t_("Parsing error: "))) 
-				ret = LoadDatAQWA(file);
-		}
-	} else if (ext == ".gdf") 
+	else if (fmt == WAMIT_DAT)
+		ret = LoadDatWamit(file);
+	else if (fmt == AQWA_DAT)
+		ret = LoadDatAQWA(file);
+	else if (fmt == WAMIT_GDF) 
 		ret = LoadGdfWamit(file, y0z, x0z); 
-	else if (ext == ".pnl") 
+	else if (fmt == HAMS_PNL) 
 		ret = LoadPnlHAMS(file, y0z, x0z); 
-	else if (ext == ".stl") {
+	else if (fmt == STL_BIN)
+		ret = LoadStlBin(file);
+	else if (fmt == STL_TXT) {
 		bool isText;
 		try {
 			LoadStl(file, mesh, isText, header);
@@ -39,6 +50,7 @@ String MeshData::Load(String file, double rho, double g, bool cleanPanels, bool
 			return std::move(e);
 		}
 		SetCode(isText ? MeshData::STL_TXT : MeshData::STL_BIN);
+		NodeWelder::Weld(mesh.panels, mesh.nodes, 0);		// Facets share nodes
 	} else
 		throw Exc(Format(t_("Unknown MESH file extension in '%s'"), file));	
 	
@@ -59,17 +71,49 @@ String MeshData::Load(String file, double rho, double g, bool cleanPanels, bool
 	
 	if (cleanPanels) {
 		Surface::RemoveDuplicatedPanels(mesh.panels);
-		Surface::RemoveDuplicatedPointsAndRenumber(mesh.panels, mesh.nodes);
+		NodeWelder::Weld(mesh.panels, mesh.nodes);
 		Surface::RemoveDuplicatedPanels(mesh.panels);
 	}
 	
-	if (!IsNull(rho))
+	if (!IsNull(rho)) {
 		AfterLoad(rho, g, false);
+		StoreCache(file, cleanPanels, y0z, x0z);
+	}
 	
 	return String();
 }
 
+// Gets the format from the extension and, for .dat and .stl, from the first bytes, so only one parser is run
+MeshData::MESH_FMT MeshData::GetFileFormat(String fileName) {
+	String ext = ToLower(GetFileExt(fileName));
+	if (ext == ".gdf")
+		return WAMIT_GDF;
+	else if (ext == ".pnl")
+		return HAMS_PNL;
+	else if (ext == ".stl") {
+		// Binary files may begin with "solid" too, so the size is checked. Some exporters pad 
+		// binary files after the facets, so longer ones are binary if they don't begin with "solid"
+		String head = MeshScan::Peek(fileName, 84);
+		if (head.GetCount() == 84) {
+			int64 len = GetFileLength(fileName), lenFacets = 84 + 50*int64(Peek32le(~head + 80));
+			if (len == lenFacets || (len > lenFacets && !ToLower(TrimLeft(head.Left(80))).StartsWith("solid")))
+				return STL_BIN;
+		}
+		return STL_TXT;
+	} else if (ext == ".dat") {
+		String head = MeshScan::Peek(fileName);
+		if (head.StartsWith("*********1*********2*********3"))
+			return AQWA_DAT;
+		int pos = head.Find('\n');
+		if (ToUpper(TrimBoth(pos >= 0 ? head.Left(pos) : head)).StartsWith("ZONE"))
+			return WAMIT_DAT;
+		return NEMOH_DAT;		// Its parser checks the header
+	}
+	return UNKNOWN;
+}
+
 void MeshData::SaveAs(String file, MESH_FMT type, double g, MESH_TYPE meshType, bool symX, bool symY) {
+	BEM_PROFILE("MeshData::SaveAs");
 	Surface surf;
 	if (meshType == UNDERWATER) 
 		surf = clone(under);
@@ -88,7 +132,7 @@ void MeshData::SaveAs(String file, MESH_FMT type, double g, MESH_TYPE meshType,
 	}
 	if (meshType == UNDERWATER || symX || symY) {// Some healing before saving
 		Surface::RemoveDuplicatedPanels(surf.panels);
-		Surface::RemoveDuplicatedPointsAndRenumber(surf.panels, surf.nodes);
+		NodeWelder::Weld(surf.panels, surf.nodes);
 		Surface::RemoveDuplicatedPanels(surf.panels);
 		Surface::DetectTriBiP(surf.panels);
 	}
@@ -131,10 +175,102 @@ void MeshData::SaveAs(String file, MESH_FMT type, double g, MESH_TYPE meshType,
 
 String MeshData::Heal(bool basic, Function <void(String, int pos)> Status) {
 	String ret = mesh.Heal(basic, Status);
-	if (!ret.IsEmpty())
-		return ret;
 	
-	return String();
+	bvh.Clear();
+	Upp::Vector<Tuple<int, int>> pairs;
+	GetBVH().GetSelfIntersections(mesh, pairs);
+	if (!pairs.IsEmpty())
+		ret << "\n" << Format(t_("%d pairs of panels cross each other, like %d and %d"), pairs.size(), pairs[0].a+1, pairs[0].b+1);
+	
+	return ret;
+}
+
+// The lock avoids two threads building it at the same time. It is cleared or refit only by the non const methods
+const PanelBVH &MeshData::GetBVH() const {
+	Mutex::Lock __(bvhMutex);
+	if (bvh.IsEmpty())
+		bvh.Build(mesh);
+	return bvh;
+}
+
+// Gets the underwater mesh. The panels fully underwater and the ones crossing the water plane are got 
+// with the BVH, so only the crossing ones are clipped. The nodes in the cuts are shared by the panels at both sides
+void MeshData::CutUnderwater() {
+	BEM_PROFILE("MeshData::CutUnderwater");
+	
+	Upp::Vector<int> crossing, below;
+	GetBVH().GetCrossingPlane(mesh, Eigen::Vector3d(0, 0, 1), 0, crossing, &below);
+	
+	under.Clear();
+	under.panels.Reserve(below.size() + 2*crossing.size());
+	under.segWaterlevel.Clear();
+	under.segWaterlevel.Reserve(crossing.size());
+	
+	Upp::Vector<int> nodeIds(mesh.nodes.size(), -1);	// Node in under of each node in mesh
+	auto GetNode = [&](int id) {
+		if (nodeIds[id] < 0) {
+			nodeIds[id] = under.nodes.size();
+			under.nodes << mesh.nodes[id];
+		}
+		return nodeIds[id];
+	};
+	VectorMap<int64, int> cutIds;						// Node in under of each cut edge
+	auto GetCutNode = [&](int id0, int id1) {
+		if (id0 > id1)
+			Swap(id0, id1);								// The same node for the panels at both sides
+		int64 key = (int64(id0) << 32) | id1;
+		int i = cutIds.Find(key);
+		if (i >= 0)
+			return cutIds[i];
+		const Point3D &p0 = mesh.nodes[id0], &p1 = mesh.nodes[id1];
+		double f = p0.z/(p0.z - p1.z);
+		int id = under.nodes.size();
+		under.nodes << Point3D(p0.x + f*(p1.x - p0.x), p0.y + f*(p1.y - p0.y), 0);
+		cutIds.Add(key, id);
+		return id;
+	};
+	
+	for (int ip : below) {
+		const Panel &pan = mesh.panels[ip];
+		Panel &p = under.panels.Add();
+		for (int i = 0; i < 4; ++i)
+			p.id[i] = GetNode(pan.id[i]);
+	}
+	for (int ip : crossing) {
+		const Panel &pan = mesh.panels[ip];
+		int num = pan.IsTriangle() ? 3 : 4;
+		int ids[5], numIds = 0;							// Clipped polygon, up to 5 sides
+		int wl[4], numWl = 0;							// Its nodes in the water line
+		for (int i = 0; i < num; ++i) {
+			int id0 = pan.id[i], id1 = pan.id[(i+1)%num];
+			double z0 = mesh.nodes[id0].z, z1 = mesh.nodes[id1].z;
+			if (z0 <= 0) {
+				ids[numIds++] = GetNode(id0);
+				if (z0 == 0)
+					wl[numWl++] = ids[numIds-1];
+			}
+			if ((z0 < 0 && z1 > 0) || (z0 > 0 && z1 < 0)) {
+				ids[numIds++] = GetCutNode(id0, id1);
+				wl[numWl++] = ids[numIds-1];
+			}
+		}
+		if (numIds < 3)
+			continue;
+		if (numWl == 2)
+			under.segWaterlevel << Segment3D(under.nodes[wl[0]], under.nodes[wl[1]]);
+		Panel &p = under.panels.Add();
+		p.id[0] = ids[0];
+		p.id[1] = ids[1];
+		p.id[2] = ids[2];
+		p.id[3] = numIds == 3 ? ids[0] : ids[3];
+		if (numIds == 5) {
+			Panel &p2 = under.panels.Add();
+			p2.id[0] = ids[0];
+			p2.id[1] = ids[3];
+			p2.id[2] = ids[4];
+			p2.id[3] = ids[0];
+		}
+	}
 }
 
 void MeshData::Orient() {
@@ -146,25 +282,99 @@ void MeshData::Join(const Surface &orig, double rho, double g) {
 	
 	AfterLoad(rho, g, false);
 }
+
+// Mirrors the mesh in the plane normal to axis. AfterLoad() has to be called later
+void MeshData::Image(int axis) {
+	MeshSoA soa(mesh);
+	soa.Mirror(axis);
+	soa.Save(mesh);
+}
 	
 void MeshData::AfterLoad(double rho, double g, bool onlyCG) {
+	BEM_PROFILE("MeshData::AfterLoad");
+	
 	if (!onlyCG) {
+		bvh.Clear();					// Panels may have changed
+		version++;
 		mesh.GetPanelParams();
-		mesh.GetLimits();
-		mesh.GetSurface();
-		mesh.GetVolume();
 		
-		under.CutZ(mesh, -1);
-		under.GetPanelParams();
-		waterPlaneArea = under.GetWaterPlaneArea();
-		under.GetSurface();
-		under.GetVolume();
+		// The underwater mesh is still cut as it is shown and saved
+		CoWork co;
+		co & [&] {mesh.GetLimits();};
+		co & [&] {
+			CutUnderwater();
+			under.GetPanelParams();
+		};
+		hs.Get(mesh);
+		co.Finish();
 		
-		if (IsNull(mass))
-			mass = under.volume*rho;
-		cb = under.GetCenterOfBuoyancy();
+		SetHydrostatics(rho, g);
+	} else
+		hs.GetC(C, rho, g, cg, mass);
+}
+
+void MeshData::Translate(double x, double y, double z, double rho, double g) {
+	cg.Translate(x, y, z);
+	mesh.Translate(x, y, z);
+	
+	AfterMove(Eigen::Matrix3d::Identity(), Eigen::Vector3d(x, y, z), rho, g);
+}
+
+void MeshData::Rotate(double ax, double ay, double az, double cx, double cy, double cz, double rho, double g) {
+	// The rigid body transform is got rotating the origin and the axes in the same way as the mesh
+	Point3D o(0, 0, 0);
+	o.Rotate(ax, ay, az, cx, cy, cz);
+	Eigen::Matrix3d R;
+	for (int i = 0; i < 3; ++i) {
+		Point3D e(i == 0, i == 1, i == 2);
+		e.Rotate(ax, ay, az, cx, cy, cz);
+		R.col(i) << e.x - o.x, e.y - o.y, e.z - o.z;
 	}
-	under.GetHydrostaticStiffness(C, cb, rho, cg, mass, g);
+	cg.Rotate(ax, ay, az, cx, cy, cz);
+	mesh.Rotate(ax, ay, az, cx, cy, cz);
+	
+	AfterMove(R, Eigen::Vector3d(o.x, o.y, o.z), rho, g);
+}
+
+// Like AfterLoad() but hydrostatics are updated incrementally, integrating only the panels 
+// whose side of the water line has changed
+void MeshData::AfterMove(const Eigen::Matrix3d &R, const Eigen::Vector3d &t, double rho, double g) {
+	BEM_PROFILE("MeshData::AfterMove");
+	
+	version++;
+	mesh.GetPanelParams();
+	
+	CoWork co;
+	co & [&] {mesh.GetLimits();};
+	co & [&] {
+		if (!bvh.IsEmpty())
+			bvh.Refit(mesh);
+		CutUnderwater();
+		under.GetPanelParams();
+	};
+	hs.Move(mesh, R, t);
+	co.Finish();
+	
+	SetHydrostatics(rho, g);
+}
+
+void MeshData::SetHydrostatics(double rho, double g) {
+	mesh.surface = hs.surface;
+	mesh.volumex = hs.volumex;
+	mesh.volumey = hs.volumey;
+	mesh.volumez = hs.volumez;
+	mesh.volume = hs.GetVolume();
+	under.surface = hs.underSurface;
+	under.volumex = hs.underVolumex;
+	under.volumey = hs.underVolumey;
+	under.volumez = hs.underVolumez;
+	under.volume = hs.GetUnderVolume();
+	waterPlaneArea = hs.wpArea;
+	
+	if (IsNull(mass))
+		mass = under.volume*rho;
+	cb = hs.GetCb();
+	hs.GetC(C, rho, g, cg, mass);
 }
 
 void MeshData::Report(double rho) {
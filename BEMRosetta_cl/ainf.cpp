@@ -24,6 +24,7 @@ double Hydro::GetK_IRF_MaxT() const {
 }
 
 void Hydro::GetK_IRF(double maxT, int numT) {
+	BEM_PROFILE("Hydro::GetK_IRF");
 	if (Nf == 0 || B.IsEmpty())
 		return;
 	
@@ -44,6 +45,7 @@ void Hydro::GetK_IRF(double maxT, int numT) {
 }  
 
 void Hydro::GetAinf() {
+	BEM_PROFILE("Hydro::GetAinf");
 	if (Nf == 0 || A.size() < Nb*6 || !IsLoadedKirf())
 		return;	
 	
@@ -56,6 +58,7 @@ void Hydro::GetAinf() {
 }
 
 void Hydro::GetAinfw() {
+	BEM_PROFILE("Hydro::GetAinfw");
 	if (Nf == 0 || A.size() < Nb*6 || !IsLoadedKirf())
 		return;	
 	
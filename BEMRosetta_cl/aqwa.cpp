@@ -4,6 +4,7 @@
 const char *textDOF[] = {"X", "Y", "Z", "RX", "RY", "RZ"};
 
 bool Aqwa::Load(String file, double) {
+	BEM_PROFILE("Aqwa::Load");
 	hd().file = file;
 	hd().name = GetFileTitle(file);
 	hd().dimen = true;
@@ -47,6 +48,7 @@ bool Aqwa::Load(String file, double) {
 }
 
 bool Aqwa::Load_AH1() {
+	BEM_PROFILE("Aqwa::Load_AH1");
 	String fileName = ForceExt(hd().file, ".AH1");
 	FileInLine in(fileName);
 	if (!in.IsOpen())
@@ -206,6 +208,7 @@ bool Aqwa::Load_AH1() {
 }
 
 bool Aqwa::Load_LIS() {
+	BEM_PROFILE("Aqwa::Load_LIS");
 	String fileName = ForceExt(hd().file, ".LIS");
 	FileInLine in(fileName);
 	if (!in.IsOpen())
@@ -485,6 +488,7 @@ bool Aqwa::Load_LIS() {
 }
 
 bool Aqwa::Load_QTF() {
+	BEM_PROFILE("Aqwa::Load_QTF");
 	String fileName = ForceExt(hd().file, ".QTF");
 	FileInLine in(fileName);
 	if (!in.IsOpen()) {
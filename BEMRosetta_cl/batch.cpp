@@ -0,0 +1,223 @@
+#include "BEMRosetta.h"
+
+static bool IsFileExt(String exts, String file) {
+	String ext = ToLower(GetFileExt(file));
+	return !ext.IsEmpty() && FindIndex(Split(exts, ' '), ext) >= 0;
+}
+
+static void GetFilesDeep(String exts, String folder, Upp::Vector<String> &files) {
+	for (FindFile ff(AppendFileName(folder, "*")); ff; ff++) {
+		if (ff.IsFolder())
+			GetFilesDeep(exts, ff.GetPath(), files);
+		else if (ff.IsFile() && IsFileExt(exts, ff.GetName()))
+			files << ff.GetPath();
+	}
+}
+
+// Leaves one file per model, as many models are split in several files with the same name (like WAMIT .1, .2, .3, .hst
+// or AQWA .lis, .ah1, .qtf), and Nemoh cases are loaded from their .cal file, so their .tec results and .dat meshes are skipped
+static void SelectModelFiles(Upp::Vector<String> &files) {
+	static const Upp::Vector<String> priority = Split(".out .1 .lis .ah1 .cal .bem .mat .tec .hst .2 .3 .4 .12s .12d .qtf .inf .dat", ' ');
+	
+	Upp::Vector<String> calFolders;
+	for (const String &file : files)
+		if (ToLower(GetFileExt(file)) == ".cal")
+			calFolders << AppendFileName(GetFileFolder(file), "");
+	
+	VectorMap<String, String> models;		// By file without extension
+	for (const String &file : files) {
+		String ext = ToLower(GetFileExt(file));
+		if (ext == ".tec" || ext == ".dat") {
+			bool inCase = false;
+			for (const String &folder : calFolders)
+				if (file.StartsWith(folder))
+					inCase = true;
+			if (inCase)
+				continue;
+		}
+		String key = ToLower(ForceExt(file, ""));
+		int id = models.Find(key);
+		if (id < 0)
+			models.Add(key, file);
+		else if (FindIndex(priority, ext) < FindIndex(priority, ToLower(GetFileExt(models[id]))))
+			models[id] = file;
+	}
+	files = models.PickValues();
+}
+
+// Input may be a folder, scanned recursively, a file pattern with wildcards, or a text file with a model per line.
+// baseFolder is the folder the relative paths in the output folder are got from
+Upp::Vector<String> BEMData::GetBatchFiles(String input, String &baseFolder) const {
+	Upp::Vector<String> files;
+
+	if (DirectoryExists(input)) {
+		baseFolder = input;
+		GetFilesDeep(bemFilesExt, input, files);
+		SelectModelFiles(files);
+	} else if (input.Find('*') >= 0 || input.Find('?') >= 0) {
+		baseFolder = GetFileFolder(input);
+		for (FindFile ff(input); ff; ff++)
+			if (ff.IsFile() && IsFileExt(bemFilesExt, ff.GetName()))
+				files << ff.GetPath();
+		SelectModelFiles(files);
+	} else if (FileExists(input)) {
+		if (IsFileExt(bemFilesExt, input)) {
+			baseFolder = GetFileFolder(input);
+			files << input;
+		} else {
+			baseFolder.Clear();
+			FileInLine in(input);
+			if (!in.IsOpen())
+				throw Exc(Format(t_("Impossible to open file '%s'"), input));
+			String folder = GetFileFolder(input);
+			while (!in.IsEof()) {
+				String line = TrimBoth(in.GetLine());
+				if (line.IsEmpty() || line[0] == '#')
+					continue;
+				if (!IsFullPath(line))
+					line = AppendFileName(folder, line);
+				files << NormalizePath(line);
+			}
+		}
+	} else
+		throw Exc(Format(t_("Batch input '%s' not found"), input));
+
+	Sort(files);
+	return files;
+}
+
+// Converts the models in input to files with extension ext, using numThreads workers.
+// Each worker has its own BEMData with the same configuration, and keeps only one model in memory.
+// Output files are saved next to the inputs, or under outFolder keeping the relative folder structure.
+// A status line "BATCH<TAB>OK|ERROR<TAB>input<TAB>output<TAB>seconds<TAB>message" is printed per file.
+// Returns the number of files with errors
+int BEMData::BatchConvert(String input, String ext, String outFolder, int numThreads) {
+	if (!ext.StartsWith("."))
+		ext = "." + ext;
+	
+	// Files with the output extension, as the ones got in a previous run, and models that would
+	// be saved in the same file are skipped
+	String baseFolder;
+	Upp::Vector<String> files, filesOut;
+	Index<String> outs;
+	for (const String &file : GetBatchFiles(input, baseFolder)) {
+		if (ToLower(GetFileExt(file)) == ToLower(ext))
+			continue;
+		String fileOut = ForceExt(file, ext);
+		if (!outFolder.IsEmpty()) {
+			String rel = baseFolder.IsEmpty() ? GetFileName(fileOut) :
+						 fileOut.Mid(AppendFileName(baseFolder, "").GetCount());
+			fileOut = AppendFileName(outFolder, rel);
+		}
+		if (outs.Find(NormalizePath(fileOut)) >= 0)
+			continue;
+		outs.Add(NormalizePath(fileOut));
+		files << file;
+		filesOut << fileOut;
+	}
+	if (files.IsEmpty())
+		throw Exc(Format(t_("No BEM file found in '%s'"), input));
+	if (IsNull(numThreads) || numThreads <= 0)
+		numThreads = CPU_Cores();
+	numThreads = min(numThreads, files.size());
+
+	String config = StoreAsJson(*this);
+	Stream &out = ConsoleOut();			// Workers threads have their own
+
+	Mutex mutex;
+	std::atomic<int> next(0), numErrors(0);
+	CoWork co;
+	for (int it = 0; it < numThreads; ++it) {
+		co & [&] {
+			// Workers output would be mixed, so it is discarded in their thread
+			NilStream nil;
+			Stream *prevOut = SetConsoleOut(&nil);
+			
+			BEMData md;
+			LoadFromJson(md, config);
+
+			for (int id = next++; id < files.size(); id = next++) {
+				const String &file = files[id];
+				const String &fileOut = filesOut[id];
+
+				TimeStop t;
+				String error;
+				try {
+					if (NormalizePath(file) == NormalizePath(fileOut))
+						throw Exc(t_("Output file would overwrite the input"));
+					if (!RealizePath(fileOut))
+						throw Exc(Format(t_("Impossible to create folder for '%s'"), fileOut));
+					md.Load(file, [](String, int) {return true;}, false);
+					md.hydros.Top().hd().SaveAs(fileOut);
+				} catch (Exc e) {
+					error = e;
+				} catch (...) {
+					error = t_("Unknown error");
+				}
+				md.hydros.Clear();
+				md.headAll.Clear();
+
+				if (!error.IsEmpty())
+					numErrors++;
+				error.Replace("\n", " ");
+				error.Replace("\t", " ");
+				Mutex::Lock __(mutex);
+				out << Format("\nBATCH\t%s\t%s\t%s\t%.3f\t%s", error.IsEmpty() ? "OK" : "ERROR",
+								file, fileOut, t.Seconds(), TrimBoth(error));
+				out.Flush();
+			}
+			SetConsoleOut(prevOut);
+		};
+	}
+	co.Finish();
+
+	return numErrors;
+}
+
+// Loads in parallel the meshes in folder and its subfolders, saving their caches so they are loaded faster later.
+// A status line "CACHE<TAB>OK|ERROR<TAB>file<TAB>seconds<TAB>message" is printed per file
+int BEMData::WarmMeshCache(String folder, bool cleanPanels, int numThreads) {
+	if (!DirectoryExists(folder))
+		throw Exc(Format(t_("Folder '%s' not found"), folder));
+	Upp::Vector<String> files;
+	GetFilesDeep(meshFilesExt, folder, files);
+	if (files.IsEmpty())
+		throw Exc(Format(t_("No mesh file found in '%s'"), folder));
+	Sort(files);
+	if (IsNull(numThreads) || numThreads <= 0)
+		numThreads = CPU_Cores();
+	numThreads = min(numThreads, files.size());
+
+	Stream &out = ConsoleOut();
+	Mutex mutex;
+	std::atomic<int> next(0), numErrors(0);
+	CoWork co;
+	for (int it = 0; it < numThreads; ++it) {
+		co & [&] {
+			for (int id = next++; id < files.size(); id = next++) {
+				const String &file = files[id];
+				TimeStop t;
+				String error;
+				try {
+					MeshData data;
+					error = data.Load(file, rho, g, cleanPanels);
+				} catch (Exc e) {
+					error = e;
+				} catch (...) {
+					error = t_("Unknown error");
+				}
+				if (!error.IsEmpty())
+					numErrors++;
+				error.Replace("\n", " ");
+				error.Replace("\t", " ");
+				Mutex::Lock __(mutex);
+				out << Format("\nCACHE\t%s\t%s\t%.3f\t%s", error.IsEmpty() ? "OK" : "ERROR",
+								file, t.Seconds(), TrimBoth(error));
+				out.Flush();
+			}
+		};
+	}
+	co.Finish();
+
+	return numErrors;
+}
@@ -0,0 +1,162 @@
+#include "BEMRosetta.h"
+#include "functions.h"
+#include <random>
+
+
+// Torus of about numPanels quads, centred in the water plane. Each panel has its own nodes, as in
+// the files that have to be welded
+static void GetTorus(Surface &surf, int numPanels) {
+	const double R = 10, r = 4;
+	int nu = max(4, int(sqrt(2.*numPanels))), nv = max(3, numPanels/nu);
+
+	surf.Clear();
+	surf.panels.Reserve(nu*nv);
+	surf.nodes.Reserve(4*nu*nv);
+	for (int iu = 0; iu < nu; ++iu) {
+		for (int iv = 0; iv < nv; ++iv) {
+			const int corners[4][2] = {{iu, iv}, {iu, iv+1}, {iu+1, iv+1}, {iu+1, iv}};
+			Panel &panel = surf.panels.Add();
+			for (int i = 0; i < 4; ++i) {
+				double u = 2*M_PI*corners[i][0]/nu, v = 2*M_PI*corners[i][1]/nv;
+				panel.id[i] = surf.nodes.size();
+				surf.nodes << Point3D((R + r*cos(v))*cos(u), (R + r*cos(v))*sin(u), r*sin(v));
+			}
+		}
+	}
+}
+
+static void PrintBench(const char *stage, int num, double seconds) {
+	ConsoleOut() << Format("\nBENCH %s %d %.3f", stage, num, seconds);
+}
+
+// Native state space fit compared with loading the same state space from a FAST .ss file
+static void BenchStateSpace(BEMData &md, const Hydro &hydro, String folder) {
+	Hydro hy(md);
+	hy.Copy(hydro);
+	TimeStop t;
+	if (!hy.GetStateSpace(Null, Null, 10, 0.05, [](String, int) {return true;}))
+		throw Exc(hy.GetLastError());
+	int numPairs = 0;
+	double maxMAE = 0;
+	for (const auto &row : hy.sts)
+		for (const Hydro::StateSpace &ss : row)
+			if (!IsNull(ss.ssMAE)) {
+				numPairs++;
+				maxMAE = max(maxMAE, ss.ssMAE);
+			}
+	PrintBench("statespace_fit", numPairs, t.Seconds());
+	ConsoleOut() << Format("\nBENCH statespace_fit_mae %d %.3g", numPairs, maxMAE);
+	
+	String file = AppendFileName(folder, "bench.ss");
+	Fast(md, &hy).Save_SS(file);
+	Hydro loaded(md);
+	loaded.Copy(hydro);
+	t.Reset();
+	bool ok = Fast(md, &loaded).Load_SS(file);
+	double seconds = t.Seconds();
+	FileDelete(file);
+	if (!ok)
+		throw Exc(Format(t_("Problem loading '%s'"), file));
+	PrintBench("statespace_load_ss", numPairs, seconds);
+}
+
+// Newman approximation compared with the full difference frequency QTF, for growing realisations
+static void BenchSlowDrift(Hydro &hydro) {
+	const double dt = 0.5, Hs = 4, Tp = 10;
+	std::mt19937_64 gen(0);
+	std::uniform_real_distribution<double> dist(0, 2*M_PI);
+	for (int N = 4096; N <= 65536; N *= 4) {
+		Hydro::WaveComponents waves;
+		int nk = N/2;
+		waves.dw = 2*M_PI/(N*dt);
+		waves.amp.resize(nk);
+		waves.phi.resize(nk);
+		for (int k = 0; k < nk; ++k) {
+			waves.amp(k) = k == 0 ? 0 : sqrt(2*JONSWAP(k*waves.dw, Hs, Tp)*waves.dw);
+			waves.phi(k) = dist(gen);
+		}
+		double duration = (N - 0.5)*dt;
+		Eigen::MatrixXd fnewman, ffull;
+		TimeStop t;
+		if (!hydro.GetSlowDriftTimeSeries(waves, hydro.qtfhead[0], 0, dt, duration, true, Null, fnewman))
+			throw Exc(hydro.GetLastError());
+		PrintBench("slowdrift_newman", N, t.Seconds());
+		t.Reset();
+		if (!hydro.GetSlowDriftTimeSeries(waves, hydro.qtfhead[0], 0, dt, duration, false, Null, ffull))
+			throw Exc(hydro.GetLastError());
+		PrintBench("slowdrift_full", N, t.Seconds());
+		double norm = ffull.norm();
+		ConsoleOut() << Format("\nBENCH slowdrift_newman_error %d %.3g", N, norm > 0 ? (fnewman - ffull).norm()/norm : 0.);
+	}
+}
+
+// Times the mesh stages for tori from 1000 to maxPanels panels: welding, loading each format,
+// AfterLoad() and the BVH queries. A line is printed per stage and size: BENCH stage panels seconds.
+// The mesh cache is disabled meanwhile, so loaders are really timed.
+// If a model is loaded, its state space fit and slow drift forces are also timed. Stages ending in 
+// _mae and _error give the fit error and the relative difference to the full QTF instead of seconds
+void RunBenchmark(BEMData &md, int maxPanels) {
+	String folder = AppendFileName(BEMData::GetTempFilesFolder(), "Bench");
+	if (!DirectoryCreateX(folder))
+		throw Exc(Format(t_("Impossible to create folder '%s'"), folder));
+	
+	if (!md.hydros.IsEmpty()) {
+		Hydro &hydro = md.hydros.Top().hd();
+		if (hydro.IsLoadedA() && hydro.IsLoadedB() && hydro.IsLoadedAwinf())
+			BenchStateSpace(md, hydro, folder);
+		if (!hydro.qtfdif.IsEmpty() && !hydro.qtfhead.IsEmpty())
+			BenchSlowDrift(hydro);
+	}
+
+	const struct {
+		MeshData::MESH_FMT type;
+		const char *name, *ext;
+	} formats[] = {{MeshData::WAMIT_GDF, "load_gdf", ".gdf"}, {MeshData::NEMOH_DAT, "load_dat", ".dat"},
+				   {MeshData::HAMS_PNL, "load_pnl", ".pnl"}, {MeshData::STL_BIN, "load_stl_bin", ".stl"},
+				   {MeshData::STL_TXT, "load_stl_txt", ".stl"}};
+
+	int64 cacheMaxSize = MeshData::GetCacheMaxSize();
+	MeshData::SetCacheMaxSize(0);
+	try {
+		for (int num = 1000; num <= maxPanels; num *= 10) {
+			MeshData data;
+			GetTorus(data.mesh, num);
+			int numPanels = data.mesh.panels.size();
+
+			TimeStop t;
+			NodeWelder::Weld(data.mesh.panels, data.mesh.nodes);
+			PrintBench("weld", numPanels, t.Seconds());
+
+			t.Reset();
+			data.AfterLoad(md.rho, md.g, false);
+			PrintBench("afterload", numPanels, t.Seconds());
+
+			t.Reset();
+			data.GetBVH();
+			PrintBench("bvh", numPanels, t.Seconds());
+
+			t.Reset();
+			Upp::Vector<Tuple<int, int>> pairs;
+			data.GetBVH().GetSelfIntersections(data.mesh, pairs);
+			PrintBench("selfintersections", numPanels, t.Seconds());
+
+			for (const auto &format : formats) {
+				String file = AppendFileName(folder, String("bench") + format.ext);
+				data.SaveAs(file, format.type, md.g, MeshData::MOVED, false, false);
+
+				t.Reset();
+				MeshData loaded;
+				String error = loaded.Load(file, md.rho, md.g, false);
+				double seconds = t.Seconds();
+				FileDelete(file);
+				if (!error.IsEmpty())
+					throw Exc(Format(t_("Problem loading '%s'") + S("\n%s"), file, error));
+				PrintBench(format.name, numPanels, seconds);
+			}
+		}
+	} catch (...) {
+		MeshData::SetCacheMaxSize(cacheMaxSize);
+		throw;
+	}
+	MeshData::SetCacheMaxSize(cacheMaxSize);
+}
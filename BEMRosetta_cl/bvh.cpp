@@ -0,0 +1,409 @@
+#include "BEMRosetta.h"
+
+using namespace Eigen;
+
+static inline Vector3d ToVector(const Point3D &p) {
+	return Vector3d(p.x, p.y, p.z);
+}
+
+static void GetPanelBox(const Surface &surf, const Panel &pan, double mn[3], double mx[3]) {
+	for (int k = 0; k < 3; ++k) {
+		mn[k] = DBL_MAX;
+		mx[k] = -DBL_MAX;
+	}
+	for (int i = 0; i < 4; ++i) {
+		const Point3D &p = surf.nodes[pan.id[i]];
+		double v[3] = {p.x, p.y, p.z};
+		for (int k = 0; k < 3; ++k) {
+			mn[k] = min(mn[k], v[k]);
+			mx[k] = max(mx[k], v[k]);
+		}
+	}
+}
+
+void PanelBVH::Node::Join(const Node &node) {
+	for (int k = 0; k < 3; ++k) {
+		mn[k] = min(mn[k], node.mn[k]);
+		mx[k] = max(mx[k], node.mx[k]);
+	}
+}
+
+// Distance squared from p to the box, 0 if inside
+double PanelBVH::Node::Distance2(const Vector3d &p) const {
+	double d2 = 0;
+	for (int k = 0; k < 3; ++k) {
+		if (p(k) < mn[k])
+			d2 += sqr(mn[k] - p(k));
+		else if (p(k) > mx[k])
+			d2 += sqr(p(k) - mx[k]);
+	}
+	return d2;
+}
+
+bool PanelBVH::Node::Overlaps(const Node &node) const {
+	for (int k = 0; k < 3; ++k)
+		if (mn[k] > node.mx[k] || mx[k] < node.mn[k])
+			return false;
+	return true;
+}
+
+// Slab test. Returns the entry distance along the ray, or Null if the box is not hit before maxDist
+double PanelBVH::Node::Raycast(const Vector3d &from, const Vector3d &invDir, double maxDist) const {
+	double t0 = 0, t1 = maxDist;
+	for (int k = 0; k < 3; ++k) {
+		double ta = (mn[k] - from(k))*invDir(k), tb = (mx[k] - from(k))*invDir(k);
+		if (ta > tb)
+			Swap(ta, tb);
+		t0 = max(t0, ta);
+		t1 = min(t1, tb);
+		if (t0 > t1)
+			return Null;
+	}
+	return t0;
+}
+
+// Panels are sorted recursively by the median of their centroids in the longest axis
+void PanelBVH::Build(const Surface &surf) {
+	BEM_PROFILE("PanelBVH::Build");
+
+	Clear();
+	int num = surf.panels.size();
+	if (num == 0)
+		return;
+
+	Upp::Vector<Point3D> centroids(num);
+	ids.SetCount(num);
+	for (int i = 0; i < num; ++i) {
+		const Panel &pan = surf.panels[i];
+		Vector3d c = (ToVector(surf.nodes[pan.id[0]]) + ToVector(surf.nodes[pan.id[1]]) +
+					  ToVector(surf.nodes[pan.id[2]]) + ToVector(surf.nodes[pan.id[3]]))/4;
+		centroids[i] = Point3D(c(0), c(1), c(2));
+		ids[i] = i;
+	}
+	nodes.Reserve(2*num/leafSize + 1);
+	BuildNode(centroids, 0, num);
+	Refit(surf);
+}
+
+int PanelBVH::BuildNode(const Upp::Vector<Point3D> &centroids, int from, int to) {
+	int id = nodes.size();
+	nodes.Add();
+	nodes[id].from = from;
+	nodes[id].to = to;
+	if (to - from <= leafSize)
+		return id;
+
+	Vector3d mn = ToVector(centroids[ids[from]]), mx = mn;
+	for (int i = from+1; i < to; ++i) {
+		Vector3d c = ToVector(centroids[ids[i]]);
+		mn = mn.cwiseMin(c);
+		mx = mx.cwiseMax(c);
+	}
+	int axis;
+	if ((mx - mn).maxCoeff(&axis) == 0)		// All centroids coincide
+		return id;
+
+	int mid = (from + to)/2;
+	std::nth_element(ids.begin() + from, ids.begin() + mid, ids.begin() + to, [&](int a, int b) {
+		const Point3D &ca = centroids[a], &cb = centroids[b];
+		return axis == 0 ? ca.x < cb.x : axis == 1 ? ca.y < cb.y : ca.z < cb.z;
+	});
+	BuildNode(centroids, from, mid);
+	int right = BuildNode(centroids, mid, to);
+	nodes[id].right = right;
+	return id;
+}
+
+// Updates the boxes after the nodes have been moved, keeping the tree. Children are after their parent
+void PanelBVH::Refit(const Surface &surf) {
+	BEM_PROFILE("PanelBVH::Refit");
+
+	for (int id = nodes.size()-1; id >= 0; --id) {
+		Node &node = nodes[id];
+		if (node.IsLeaf()) {
+			GetPanelBox(surf, surf.panels[ids[node.from]], node.mn, node.mx);
+			for (int i = node.from+1; i < node.to; ++i) {
+				Node box;
+				GetPanelBox(surf, surf.panels[ids[i]], box.mn, box.mx);
+				node.Join(box);
+			}
+		} else {
+			const Node &left = nodes[id+1];
+			memcpy(node.mn, left.mn, sizeof(node.mn));
+			memcpy(node.mx, left.mx, sizeof(node.mx));
+			node.Join(nodes[node.right]);
+		}
+	}
+}
+
+// Panels whose nodes are at both sides of the plane normal·p = d. If below is not null, it gets the panels 
+// with all their nodes at the negative side or on the plane. Only the boxes crossed by the plane are tested panel by panel
+void PanelBVH::GetCrossingPlane(const Surface &surf, const Vector3d &normal, double d, Upp::Vector<int> &panels, 
+								Upp::Vector<int> *below) const {
+	panels.Clear();
+	if (below)
+		below->Clear();
+	if (nodes.IsEmpty())
+		return;
+
+	Upp::Vector<int> stack;
+	stack << 0;
+	while (!stack.IsEmpty()) {
+		int id = stack.Pop();
+		const Node &node = nodes[id];
+		double s = -d, r = 0;
+		for (int k = 0; k < 3; ++k) {
+			s += normal(k)*(node.mn[k] + node.mx[k])/2;
+			r += abs(normal(k))*(node.mx[k] - node.mn[k])/2;
+		}
+		if (s > r)
+			continue;
+		if (s < -r) {
+			if (below)
+				below->Append(ids, node.from, node.to - node.from);
+			continue;
+		}
+		if (node.IsLeaf()) {
+			for (int i = node.from; i < node.to; ++i) {
+				const Panel &pan = surf.panels[ids[i]];
+				bool isBelow = false, isAbove = false;
+				for (int j = 0; j < 4; ++j) {
+					double dist = normal.dot(ToVector(surf.nodes[pan.id[j]])) - d;
+					isBelow = isBelow || dist < 0;
+					isAbove = isAbove || dist > 0;
+				}
+				if (isBelow && isAbove)
+					panels << ids[i];
+				else if (isBelow && below)
+					*below << ids[i];
+			}
+		} else {
+			stack << id + 1;
+			stack << node.right;
+		}
+	}
+	Sort(panels);
+	if (below)
+		Sort(*below);
+}
+
+// Möller–Trumbore. Returns the distance along dir, or Null if there is no hit
+static double RaycastTriangle(const Vector3d &from, const Vector3d &dir, const Vector3d &a, const Vector3d &b, const Vector3d &c) {
+	Vector3d e1 = b - a, e2 = c - a;
+	Vector3d p = dir.cross(e2);
+	double det = e1.dot(p);
+	if (abs(det) < 1E-14*e1.squaredNorm()*e2.norm()*dir.norm())
+		return Null;
+	Vector3d s = from - a;
+	double u = s.dot(p)/det;
+	if (u < 0 || u > 1)
+		return Null;
+	Vector3d q = s.cross(e1);
+	double v = dir.dot(q)/det;
+	if (v < 0 || u + v > 1)
+		return Null;
+	return e2.dot(q)/det;
+}
+
+// Returns the first panel hit by the ray from + t·dir, t >= 0, or -1. dist is t
+int PanelBVH::Raycast(const Surface &surf, const Point3D &_from, const Point3D &_dir, double &dist) const {
+	dist = DBL_MAX;
+	if (nodes.IsEmpty())
+		return -1;
+
+	Vector3d from = ToVector(_from), dir = ToVector(_dir);
+	Vector3d invDir(1/dir(0), 1/dir(1), 1/dir(2));		// Infinite values work in the slab test
+	int idPanel = -1;
+	Upp::Vector<int> stack;
+	stack << 0;
+	while (!stack.IsEmpty()) {
+		int id = stack.Pop();
+		const Node &node = nodes[id];
+		if (IsNull(node.Raycast(from, invDir, dist)))
+			continue;
+		if (node.IsLeaf()) {
+			for (int i = node.from; i < node.to; ++i) {
+				const Panel &pan = surf.panels[ids[i]];
+				Vector3d p0 = ToVector(surf.nodes[pan.id[0]]), p2 = ToVector(surf.nodes[pan.id[2]]);
+				double t0 = RaycastTriangle(from, dir, p0, ToVector(surf.nodes[pan.id[1]]), p2);
+				double t1 = pan.IsTriangle() ? Null : RaycastTriangle(from, dir, p0, p2, ToVector(surf.nodes[pan.id[3]]));
+				for (double t : {t0, t1})
+					if (!IsNull(t) && t >= 0 && t < dist) {
+						dist = t;
+						idPanel = ids[i];
+					}
+			}
+		} else {
+			stack << id + 1;
+			stack << node.right;
+		}
+	}
+	if (idPanel < 0)
+		dist = Null;
+	return idPanel;
+}
+
+// Closest point to p in triangle a, b, c, from "Real-Time Collision Detection", C. Ericson
+static Vector3d ClosestPointTriangle(const Vector3d &p, const Vector3d &a, const Vector3d &b, const Vector3d &c) {
+	Vector3d ab = b - a, ac = c - a, ap = p - a;
+	double d1 = ab.dot(ap), d2 = ac.dot(ap);
+	if (d1 <= 0 && d2 <= 0)
+		return a;
+	Vector3d bp = p - b;
+	double d3 = ab.dot(bp), d4 = ac.dot(bp);
+	if (d3 >= 0 && d4 <= d3)
+		return b;
+	double vc = d1*d4 - d3*d2;
+	if (vc <= 0 && d1 >= 0 && d3 <= 0)
+		return a + d1/(d1 - d3)*ab;
+	Vector3d cp = p - c;
+	double d5 = ab.dot(cp), d6 = ac.dot(cp);
+	if (d6 >= 0 && d5 <= d6)
+		return c;
+	double vb = d5*d2 - d1*d6;
+	if (vb <= 0 && d2 >= 0 && d6 <= 0)
+		return a + d2/(d2 - d6)*ac;
+	double va = d3*d6 - d5*d4;
+	if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+		return b + (d4 - d3)/((d4 - d3) + (d5 - d6))*(c - b);
+	double den = va + vb + vc;
+	if (den == 0)
+		return a;
+	return a + ab*(vb/den) + ac*(vc/den);
+}
+
+// Returns the panel closest to p, or -1 if there are no panels. dist is the distance
+int PanelBVH::GetNearest(const Surface &surf, const Point3D &_p, double &dist) const {
+	dist = Null;
+	if (nodes.IsEmpty())
+		return -1;
+
+	Vector3d p = ToVector(_p);
+	double dist2 = DBL_MAX;
+	int idPanel = -1;
+	Upp::Vector<int> stack;
+	stack << 0;
+	while (!stack.IsEmpty()) {
+		int id = stack.Pop();
+		const Node &node = nodes[id];
+		if (node.Distance2(p) >= dist2)
+			continue;
+		if (node.IsLeaf()) {
+			for (int i = node.from; i < node.to; ++i) {
+				const Panel &pan = surf.panels[ids[i]];
+				Vector3d p0 = ToVector(surf.nodes[pan.id[0]]), p2 = ToVector(surf.nodes[pan.id[2]]);
+				double d2 = (ClosestPointTriangle(p, p0, ToVector(surf.nodes[pan.id[1]]), p2) - p).squaredNorm();
+				if (!pan.IsTriangle())
+					d2 = min(d2, (ClosestPointTriangle(p, p0, p2, ToVector(surf.nodes[pan.id[3]])) - p).squaredNorm());
+				if (d2 < dist2) {
+					dist2 = d2;
+					idPanel = ids[i];
+				}
+			}
+		} else {		// Closest child first
+			int left = id + 1;
+			if (nodes[left].Distance2(p) < nodes[node.right].Distance2(p)) {
+				stack << node.right;
+				stack << left;
+			} else {
+				stack << left;
+				stack << node.right;
+			}
+		}
+	}
+	dist = sqrt(dist2);
+	return idPanel;
+}
+
+static bool SegmentCrossesTriangle(const Vector3d &p0, const Vector3d &p1, const Vector3d &a, const Vector3d &b, const Vector3d &c) {
+	double t = RaycastTriangle(p0, p1 - p0, a, b, c);
+	return !IsNull(t) && t > 0 && t < 1;
+}
+
+static bool TrianglesCross(const Vector3d t1[3], const Vector3d t2[3]) {
+	for (int i = 0; i < 3; ++i) {
+		if (SegmentCrossesTriangle(t1[i], t1[(i+1)%3], t2[0], t2[1], t2[2]))
+			return true;
+		if (SegmentCrossesTriangle(t2[i], t2[(i+1)%3], t1[0], t1[1], t1[2]))
+			return true;
+	}
+	return false;
+}
+
+static void GetTriangles(const Surface &surf, const Panel &pan, Vector3d tri[2][3]) {
+	tri[0][0] = tri[1][0] = ToVector(surf.nodes[pan.id[0]]);
+	tri[0][1] = ToVector(surf.nodes[pan.id[1]]);
+	tri[0][2] = tri[1][1] = ToVector(surf.nodes[pan.id[2]]);
+	tri[1][2] = ToVector(surf.nodes[pan.id[3]]);
+}
+
+static bool ShareNode(const Panel &a, const Panel &b) {
+	for (int i = 0; i < 4; ++i)
+		for (int j = 0; j < 4; ++j)
+			if (a.id[i] == b.id[j])
+				return true;
+	return false;
+}
+
+// Pairs of panels that cross each other, when an edge of one goes through the other.
+// Panels sharing nodes and coplanar overlaps are not checked
+void PanelBVH::GetSelfIntersections(const Surface &surf, Upp::Vector<Tuple<int, int>> &pairs) const {
+	BEM_PROFILE("PanelBVH::GetSelfIntersections");
+
+	pairs.Clear();
+	int num = surf.panels.size();
+	if (nodes.IsEmpty() || num == 0)
+		return;
+
+	const int blockSize = 1024;
+	int numBlocks = (num + blockSize - 1)/blockSize;
+	Upp::Array<Upp::Vector<Tuple<int, int>>> partial(numBlocks);
+	CoWork co;
+	for (int ib = 0; ib < numBlocks; ++ib) {
+		co & [&, ib] {
+			Upp::Vector<int> stack;
+			for (int ip = ib*blockSize; ip < min(num, (ib+1)*blockSize); ++ip) {
+				const Panel &pan = surf.panels[ip];
+				Node box;
+				GetPanelBox(surf, pan, box.mn, box.mx);
+				Vector3d tri[2][3];
+				GetTriangles(surf, pan, tri);
+
+				stack.Clear();
+				stack << 0;
+				while (!stack.IsEmpty()) {
+					int id = stack.Pop();
+					const Node &node = nodes[id];
+					if (!node.Overlaps(box))
+						continue;
+					if (node.IsLeaf()) {
+						for (int i = node.from; i < node.to; ++i) {
+							int ip2 = ids[i];
+							if (ip2 <= ip)
+								continue;
+							const Panel &pan2 = surf.panels[ip2];
+							if (ShareNode(pan, pan2))
+								continue;
+							Vector3d tri2[2][3];
+							GetTriangles(surf, pan2, tri2);
+							bool cross = false;
+							for (int i1 = 0; i1 < (pan.IsTriangle() ? 1 : 2) && !cross; ++i1)
+								for (int i2 = 0; i2 < (pan2.IsTriangle() ? 1 : 2) && !cross; ++i2)
+									cross = TrianglesCross(tri[i1], tri2[i2]);
+							if (cross)
+								partial[ib] << Tuple<int, int>(ip, ip2);
+						}
+					} else {
+						stack << id + 1;
+						stack << node.right;
+					}
+				}
+			}
+			Sort(partial[ib]);
+		};
+	}
+	co.Finish();
+
+	for (const Upp::Vector<Tuple<int, int>> &p : partial)
+		pairs.Append(p);
+}
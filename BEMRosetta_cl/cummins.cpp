@@ -0,0 +1,226 @@
+#include "BEMRosetta.h"
+#include "FastOut.h"
+
+using namespace Eigen;
+
+// Linear time domain simulation with Cummins equation, for all cases in parallel:
+// (M + A∞)·d2x + μ(t) + Dlin·dx + Dquad·dx|dx| + (C + Cmoor)·x = f(t)
+// Radiation memory μ(t) is got from the state space sts if stateSpace, or else from the convolution of Kirf
+// up to memoryT seconds, with the velocity history kept in a ring buffer.
+// Integration is fixed step RK4, with μ(t) kept constant along the step when it is a convolution
+bool Hydro::Cummins(const MatrixXd &_M, const MatrixXd &Dlin, const MatrixXd &Dquad, const MatrixXd &Cmoor,
+			double dt, double duration, double memoryT, bool stateSpace, Upp::Array<TimeDomainCase> &cases) {
+	if (!IsLoadedAwinf()) {
+		lastError = t_("A∞ is required for time domain simulation");
+		return false;
+	}
+	if (stateSpace && (!IsLoadedStateSpace() || !dimenSTS)) {
+		lastError = t_("Dimensional state space data is required for time domain simulation");
+		return false;
+	}
+	if (!stateSpace && !IsLoadedKirf()) {
+		lastError = t_("Kirf is required for time domain simulation");
+		return false;
+	}
+	if (dt <= 0 || duration <= 0) {
+		lastError = t_("Wrong time step or duration");
+		return false;
+	}
+	int ndof = 6*Nb;
+	MatrixXd mass;
+	if (!GetMassMatrix(_M, mass) || !CheckDynMatrices(mass, Dlin, Dquad, Cmoor))
+		return false;
+
+	Upp::Vector<int> dofs;
+	for (int idf = 0; idf < ndof; ++idf)
+		if (!IsNull(Awinf(idf, idf)))
+			dofs << idf;
+	int n = dofs.size();
+	if (n == 0) {
+		lastError = t_("No DOF available for time domain simulation");
+		return false;
+	}
+
+	MatrixXd Mt(n, n), K = MatrixXd::Zero(n, n), Dl = MatrixXd::Zero(n, n), Dq = MatrixXd::Zero(n, n);
+	for (int i = 0; i < n; ++i) {
+		int idf = dofs[i], ib = idf/6;
+		for (int j = 0; j < n; ++j) {
+			int jdf = dofs[j], jb = jdf/6;
+			Mt(i, j) = mass(idf, jdf) + (IsNull(Awinf(idf, jdf)) ? 0 : Awinf_dim(idf, jdf));
+			if (IsLoadedC() && ib == jb)
+				K(i, j) = C_dim(ib, idf - 6*ib, jdf - 6*jb);
+			if (Cmoor.size() > 0)
+				K(i, j) += Cmoor(idf, jdf);
+			if (Dlin.size() > 0)
+				Dl(i, j) = Dlin(idf, jdf);
+			if (Dquad.size() > 0)
+				Dq(i, j) = Dquad(idf, jdf);
+		}
+	}
+	bool isQuad = !Dq.isZero();
+	MatrixXd Minv = Mt.inverse();
+
+	// Kirf resampled to dt. Kl[l](i, j) = K_ij(l·dt)
+	Upp::Array<MatrixXd> Kl;
+	if (!stateSpace) {
+		double maxT = Tirf[Tirf.size()-1];
+		if (!IsNull(memoryT) && memoryT > 0)
+			maxT = min(maxT, memoryT);
+		int L = max(1, int(maxT/dt) + 1);
+		double dT = Tirf[1] - Tirf[0];
+		Kl.SetCount(L);
+		for (int l = 0; l < L; ++l) {
+			double t = l*dt;
+			int it = min(int(t/dT), int(Tirf.size()) - 2);
+			double ft = (t - Tirf[it])/dT;
+			Kl[l].setZero(n, n);
+			for (int i = 0; i < n; ++i)
+				for (int j = 0; j < n; ++j) {
+					const VectorXd &k = Kirf[dofs[i]][dofs[j]];
+					if (k.size() == 0 || IsNull(k[it]))
+						continue;
+					double k0 = Kirf_dim(it, dofs[i], dofs[j]), k1 = Kirf_dim(it+1, dofs[i], dofs[j]);
+					Kl[l](i, j) = (k0 + ft*(k1 - k0))*(l == 0 ? dt/2 : dt);	// Trapezoidal weights
+				}
+		}
+	}
+
+	// State space blocks. Force on i from the velocity of j is C_ss·z, dz = A_ss·z + B_ss·v_j
+	struct SsBlock {
+		int i, j, pos, sz;
+	};
+	Upp::Vector<SsBlock> blocks;
+	int nz = 0;
+	double ssFactor = g_rho_dim()/g_rho_ndim();
+	if (stateSpace) {
+		for (int i = 0; i < n; ++i)
+			for (int j = 0; j < n; ++j) {
+				const StateSpace &st = sts[dofs[i]][dofs[j]];
+				if (st.A_ss.size() == 0)
+					continue;
+				SsBlock &b = blocks.Add();
+				b.i = i;
+				b.j = j;
+				b.pos = nz;
+				b.sz = int(st.A_ss.rows());
+				nz += b.sz;
+			}
+	}
+
+	Eigen::Index numT = Eigen::Index(duration/dt) + 1;
+
+	try {
+		CoWork co;
+		for (int ic = 0; ic < cases.size(); ++ic) {
+			co & [&, ic] {
+				TimeDomainCase &cs = cases[ic];
+				cs.x.setZero(numT, ndof);
+				cs.v.setZero(numT, ndof);
+
+				VectorXd x = VectorXd::Zero(n), v = VectorXd::Zero(n), z = VectorXd::Zero(nz);
+				for (int i = 0; i < n; ++i) {
+					if (cs.x0.size() == ndof)
+						x(i) = cs.x0(dofs[i]);
+					if (cs.v0.size() == ndof)
+						v(i) = cs.v0(dofs[i]);
+				}
+				auto Force = [&](double t)->VectorXd {
+					VectorXd f = VectorXd::Zero(n);
+					if (cs.f.rows() < 1)
+						return f;
+					double id = t/dt;
+					Eigen::Index it = min(Eigen::Index(id), cs.f.rows()-1);
+					Eigen::Index it1 = min(it+1, cs.f.rows()-1);
+					double ft = id - it;
+					for (int i = 0; i < n; ++i)
+						f(i) = cs.f(it, dofs[i]) + ft*(cs.f(it1, dofs[i]) - cs.f(it, dofs[i]));
+					return f;
+				};
+				auto Deriv = [&](double t, const VectorXd &x, const VectorXd &v, const VectorXd &z, const VectorXd &mu,
+								 VectorXd &dv, VectorXd &dz) {
+					VectorXd rhs = Force(t) - mu - Dl*v - K*x;
+					if (isQuad)
+						rhs -= Dq*v.cwiseProduct(v.cwiseAbs());
+					dz.resize(nz);
+					for (const SsBlock &b : blocks) {
+						const StateSpace &st = sts[dofs[b.i]][dofs[b.j]];
+						auto zb = z.segment(b.pos, b.sz);
+						rhs(b.i) -= ssFactor*st.C_ss.dot(zb);
+						dz.segment(b.pos, b.sz) = st.A_ss*zb + st.B_ss*v(b.j);
+					}
+					dv = Minv*rhs;
+				};
+
+				// Ring buffer with the velocity history. hist.col(head) is the last one
+				int L = Kl.size();
+				MatrixXd hist = MatrixXd::Zero(n, max(L, 1));
+				int head = 0;
+				VectorXd mu = VectorXd::Zero(n);
+				VectorXd k1v, k2v, k3v, k4v, k1z, k2z, k3z, k4z;
+
+				for (Eigen::Index it = 0; it < numT; ++it) {
+					for (int i = 0; i < n; ++i) {
+						cs.x(it, dofs[i]) = x(i);
+						cs.v(it, dofs[i]) = v(i);
+					}
+					if (it == numT-1)
+						break;
+					double t = it*dt;
+
+					if (L > 0) {
+						hist.col(head) = v;
+						mu.setZero();
+						for (int l = 0, id = head; l < L; ++l) {
+							mu += Kl[l]*hist.col(id);
+							if (--id < 0)
+								id = L-1;
+						}
+					}
+					Deriv(t, x, v, z, mu, k1v, k1z);
+					VectorXd v2 = v + dt/2*k1v;
+					Deriv(t + dt/2, x + dt/2*v, v2, z + dt/2*k1z, mu, k2v, k2z);
+					VectorXd v3 = v + dt/2*k2v;
+					Deriv(t + dt/2, x + dt/2*v2, v3, z + dt/2*k2z, mu, k3v, k3z);
+					VectorXd v4 = v + dt*k3v;
+					Deriv(t + dt, x + dt*v3, v4, z + dt*k3z, mu, k4v, k4z);
+
+					x += dt/6*(v + 2*v2 + 2*v3 + v4);
+					v += dt/6*(k1v + 2*k2v + 2*k3v + k4v);
+					if (nz > 0)
+						z += dt/6*(k1z + 2*k2z + 2*k3z + k4z);
+					if (L > 0 && ++head >= L)
+						head = 0;
+				}
+			};
+		}
+		co.Finish();
+	} catch (Exc e) {
+		lastError = e;
+		return false;
+	}
+	return true;
+}
+
+// Saves the case in FAST .out text format. Rotations are saved in deg
+void Hydro::SaveTimeDomainOut(String fileName, const TimeDomainCase &cs, double dt) {
+	static const char *names[] = {"Surge", "Sway", "Heave", "Roll", "Pitch", "Yaw"};
+
+	FastOut out;
+	int ndof = int(cs.x.cols());
+	out.parameters << "Time";
+	out.units << "s";
+	out.dataOut.SetCount(1 + ndof);
+	for (int idf = 0; idf < ndof; ++idf) {
+		int ib = idf/6, i = idf - 6*ib;
+		out.parameters << (ib == 0 ? String("Ptfm") : Format("Ptfm%d", ib+1)) + names[i];
+		out.units << (i < 3 ? "m" : "deg");
+	}
+	for (Eigen::Index it = 0; it < cs.x.rows(); ++it) {
+		out.dataOut[0] << it*dt;
+		for (int idf = 0; idf < ndof; ++idf) {
+			int i = idf%6;
+			out.dataOut[1 + idf] << (i < 3 ? cs.x(it, idf) : ToDeg(cs.x(it, idf)));
+		}
+	}
+	out.Save(fileName);
+}
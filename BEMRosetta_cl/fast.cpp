@@ -7,6 +7,7 @@
 #include <plugin/zstd/zstd.h>
 
 bool Fast::Load(String file, double g) {
+	BEM_PROFILE("Fast::Load");
 	hd().file = file;	
 	hd().name = GetFileTitle(file);
 	
@@ -53,6 +54,7 @@ bool Fast::Load(String file, double g) {
 }
 
 bool Fast::Load_HydroDyn() {
+	BEM_PROFILE("Fast::Load_HydroDyn");
 	FileInLine in(hd().file);
 	if (!in.IsOpen())
 		return false;
@@ -94,6 +96,7 @@ bool Fast::Load_HydroDyn() {
 
 
 void Fast::Save(String file, int qtfHeading) {
+	BEM_PROFILE("Fast::Save");
 	try {
 		file = ForceExt(file, ".dat");
 		
@@ -119,6 +122,7 @@ void Fast::Save(String file, int qtfHeading) {
 }
 
 void Fast::Save_HydroDyn(String fileName, bool force) {
+	BEM_PROFILE("Fast::Save_HydroDyn");
 	String strFile;
 	
 	if (hydroFolder.IsEmpty())
@@ -272,6 +276,7 @@ void Fast::Save_HydroDyn(String fileName, bool force) {
 
 // Just can save the first body			
 void Fast::Save_SS(String fileName) {
+	BEM_PROFILE("Fast::Save_SS");
 	FileOut out(fileName);
 	if (!out.IsOpen())
 		throw Exc(Format(t_("Impossible to open '%s'"), fileName));
@@ -396,6 +401,7 @@ static bool FillDOF(const Eigen::MatrixXd &C, int idf, int pos, int nstates, Vec
 }			
 
 bool Fast::Load_SS(String fileName) {
+	BEM_PROFILE("Fast::Load_SS");
 	FileInLine in(fileName);
 	if (!in.IsOpen())
 		return false;
@@ -475,10 +481,10 @@ bool Fast::Load_SS(String fileName) {
 					sts.C_ss(r)    = C(jdf, pos + r);
 				}		 
 			}
-			sts.GetTFS(hd().w);
 			pos += num;
 		}
 	}
+	hd().GetTFS(hd().w);
 	return true;
 }
 
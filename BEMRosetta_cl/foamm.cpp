@@ -3,6 +3,7 @@
 #include <Matio/matio.h>
 
 bool Foamm::Load(String file) {
+	BEM_PROFILE("Foamm::Load");
 	hd().code = Hydro::FOAMM;
 	hd().file = file;	
 	hd().name = GetFileTitle(file);
@@ -39,6 +40,7 @@ bool Foamm::Load(String file) {
 }
 
 bool Foamm::Load_mat(String file, int idf, int jdf, bool loadCoeff) {
+	BEM_PROFILE("Foamm::Load_mat");
 	MatFile mat;
 	
 	if (!mat.OpenRead(file)) 
@@ -161,49 +163,155 @@ bool Foamm::Load_mat(String file, int idf, int jdf, bool loadCoeff) {
 
 void Foamm::Get(const Vector<int> &ibs, const Vector<int> &idfs, const Vector<int> &jdfs,
 		const Vector<double> &froms, const Vector<double> &tos, const Vector<Vector<double>> &freqs, 
-		Function <bool(String, int)> Status, Function <void(String)> FOAMMMessage) {
+		Function <bool(String, int)> Status, Function <void(String)> FOAMMMessage, 
+		Function <bool(int)> IsCaseCancelled, int numThreads) {
 	if (!FileExists(hd().GetBEMData().foammPath))
 		throw Exc(t_("FOAMM not found. Please set FOAMM path in Options"));
-	for (int i = 0; i < ibs.size(); ++i) {
-		Status(Format(t_("Processing case %d"), i+1), int((100*i)/ibs.size()));
-		Get_Each(ibs[i], idfs[i], jdfs[i], froms[i], tos[i], freqs[i], Status, FOAMMMessage);
+	
+	int num = ibs.size();
+	if (IsNull(numThreads) || numThreads < 1)
+		numThreads = CPU_Cores();
+	
+	auto Message = [&](int icase, const String &reso, const String &rese) {
+		String msg;
+		if (!reso.IsEmpty())
+			msg << reso;
+		if (!rese.IsEmpty()) {
+			if (!msg.IsEmpty())
+				msg << ";";
+			msg << rese;
+		}
+		if (!msg.IsEmpty() && !msg.StartsWith("MAE:")) {
+			if (num > 1)
+				msg = Format(t_("Case %d: %s"), icase+1, msg);
+			FOAMMMessage(msg);
+		}
+	};
+	
+	Array<FoammCase> running;
+	Vector<String> errors;
+	int next = 0, done = 0;
+	try {
+		while (next < num || !running.IsEmpty()) {
+			while (running.size() < numThreads && next < num) {	// Fills the pool
+				FoammCase &cs = running.Add();
+				cs.icase = next++;
+				cs.Prepare(*this, ibs[cs.icase], idfs[cs.icase], jdfs[cs.icase], froms[cs.icase], 
+						   tos[cs.icase], freqs[cs.icase]);
+				if (!cs.process.Start(hd().GetBEMData().foammPath, NULL, cs.folder))
+					throw Exc(Format(t_("Problem launching FOAMM from '%s'"), cs.file));
+			}
+			
+			bool idle = true;
+			for (int i = running.size()-1; i >= 0; --i) {
+				FoammCase &cs = running[i];
+				String reso, rese;
+				cs.process.Read2(reso, rese);
+				bool isRunning = cs.process.IsRunning();
+				if (!isRunning) {		// Output written between the last read and the exit
+					while (true) {
+						String o, e;
+						cs.process.Read2(o, e);
+						if (o.IsEmpty() && e.IsEmpty())
+							break;
+						reso << o;
+						rese << e;
+					}
+				}
+				if (!reso.IsEmpty() || !rese.IsEmpty()) {
+					Message(cs.icase, reso, rese);
+					idle = false;
+				}
+				if (isRunning) {
+					if (IsCaseCancelled && IsCaseCancelled(cs.icase)) {
+						cs.process.Kill();
+						cs.cancelled = true;
+					}
+					continue;
+				}
+				idle = false;
+				if (cs.cancelled) 
+					BEMData::Print("\n" + Format(t_("FOAMM case %d cancelled by user"), cs.icase+1));
+				else if (cs.process.GetExitCode() != 0)
+					errors << Format(t_("FOAMM case %d ended with error"), cs.icase+1);
+				else {
+					try {
+						Load_mat(cs.file, cs.idf, cs.jdf, false);	// Results are loaded as soon as they are available
+					} catch (Exc e) {
+						errors << Format(t_("FOAMM case %d: %s"), cs.icase+1, e);
+					}
+				}
+				DeleteFolderDeep(cs.folder);
+				running.Remove(i);
+				done++;
+				Status(Format(t_("Processed case %d of %d"), done, num), int((100*done)/num));
+			}
+			if (Status("", Null)) 
+				throw Exc(t_("Process ended by user"));
+			if (idle)		// No pipe activity nor process finished
+				Sleep(10);
+		}
+	} catch (Exc e) {
+		for (int i = 0; i < running.size(); ++i) {
+			running[i].process.Kill();
+			DeleteFolderDeep(running[i].folder);
+		}
+		throw;
 	}
+	if (!errors.IsEmpty())
+		throw Exc(Join(errors, "\n"));
 }
 
-void Foamm::Get_Each(int ibody, int _idf, int _jdf, double from, double to, const Vector<double> &freqs, 
+void Foamm::Get_Each(int ibody, int idf, int jdf, double from, double to, const Vector<double> &freqs, 
 		Function <bool(String, int)> Status, Function <void(String)> FOAMMMessage) {
+	Vector<int> ibs, idfs, jdfs;
+	Vector<double> froms, tos;
+	Vector<Vector<double>> freqss;
+	ibs << ibody;
+	idfs << idf;
+	jdfs << jdf;
+	froms << from;
+	tos << to;
+	freqss << clone(freqs);
+	Get(ibs, idfs, jdfs, froms, tos, freqss, Status, FOAMMMessage, Null, 1);
+}
+
+void Foamm::FoammCase::Prepare(Foamm &foamm, int ibody, int _idf, int _jdf, double from, double to, 
+		const Vector<double> &freqs) {
+	Hydro &hd = foamm.hd();
+	
 	Uuid id = Uuid::Create();
-	String folder = AppendFileName(BEMData::GetTempFilesFolder(), Format(id));
+	folder = AppendFileName(BEMData::GetTempFilesFolder(), Format(id));
 	if (!DirectoryCreateX(folder))
 		throw Exc(Format(t_("Problem creating temporary FOAMM folder '%s'"), folder));			
-	String file = AppendFileName(folder, "temp_file.mat");
+	file = AppendFileName(folder, "temp_file.mat");
 	
 	MatFile mat;
 	
 	if (!mat.OpenCreate(file, MAT_FT_MAT5)) 
 		throw Exc(Format(t_("Problem creating FOAMM file '%s'"), file));
 
-	int idf = ibody*6 + _idf;
-	int jdf = ibody*6 + _jdf;
+	idf = ibody*6 + _idf;
+	jdf = ibody*6 + _jdf;
 
-	MatMatrix<double> matA(hd().Nf, 1);
-	for (int ifr = 0; ifr < hd().Nf; ++ifr)
-		matA(ifr, 0) = hd().A_dim(ifr, idf, jdf);
+	MatMatrix<double> matA(hd.Nf, 1);
+	for (int ifr = 0; ifr < hd.Nf; ++ifr)
+		matA(ifr, 0) = hd.A_dim(ifr, idf, jdf);
  	if (!mat.VarWrite("A", matA))
  		throw Exc(Format(t_("Problem writing %s to file '%s'"), "A", file));
 
- 	if (!mat.VarWrite<double>("Mu", hd().Awinf_dim(idf, jdf)))
+ 	if (!mat.VarWrite<double>("Mu", hd.Awinf_dim(idf, jdf)))
  		throw Exc(Format(t_("Problem writing %s to file '%s'"), "Mu", file));
  		 	
-	MatMatrix<double> matB(hd().Nf, 1);
-	for (int ifr = 0; ifr < hd().Nf; ++ifr)
-		matB(ifr, 0) = hd().B_dim(ifr, idf, jdf);
+	MatMatrix<double> matB(hd.Nf, 1);
+	for (int ifr = 0; ifr < hd.Nf; ++ifr)
+		matB(ifr, 0) = hd.B_dim(ifr, idf, jdf);
 	if (!mat.VarWrite("B", matB))
  		throw Exc(Format(t_("Problem writing %s to file '%s'"), "B", file));
 	
-	MatMatrix<double> matw(1, hd().Nf);
-	for (int ifr = 0; ifr < hd().Nf; ++ifr)
-		matw(0, ifr) = hd().w[ifr];
+	MatMatrix<double> matw(1, hd.Nf);
+	for (int ifr = 0; ifr < hd.Nf; ++ifr)
+		matw(0, ifr) = hd.w[ifr];
 	if (!mat.VarWrite("w", matw))
  		throw Exc(Format(t_("Problem writing %s to file '%s'"), "w", file));
 	
@@ -251,42 +359,4 @@ void Foamm::Get_Each(int ibody, int _idf, int _jdf, double from, double to, cons
 	mat.VarWrite(options);
 	
 	mat.Close();
-	
-	LocalProcess process;
-	if (!process.Start(hd().GetBEMData().foammPath, NULL, folder))
-		throw Exc(Format(t_("Problem launching FOAMM from '%s'"), file));
-
-	String msg, reso, rese;
-	bool endProcess = false;
-	while (process.IsRunning()) {
-		if (!endProcess) {
-			if (process.Read2(reso, rese)) {
-				msg.Clear();
-				if (!reso.IsEmpty())
-					msg << reso;
-				if (!rese.IsEmpty()) {
-					if (!msg.IsEmpty())
-						msg << ";";
-					msg << rese;
-				}
-				if (!msg.IsEmpty() && !msg.StartsWith("MAE:"))
-					FOAMMMessage(msg);
-			}
-			endProcess = Status("", Null); 
-			if (endProcess)
-				process.Kill();
-		}
-		Sleep(200);
-	}
-	if (endProcess) {
-		DeleteFolderDeep(folder);	Sleep(100);
-		throw Exc(t_("Process ended by user"));
-	}
-	if (process.GetExitCode() != 0) {
-		DeleteFolderDeep(folder);	Sleep(100);
-		throw Exc(t_("FOAMM ended with error"));
-	}
-	Load_mat(file, idf, jdf, false);
-	DeleteFolderDeep(folder);		Sleep(100);
 }
-
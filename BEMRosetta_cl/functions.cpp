@@ -1,7 +1,7 @@
 #include "BEMRosetta.h"
-#include <STEM4U/Sundials.h>
 #include <STEM4U/Integral.h>
 #include <STEM4U/Utility.h>
+#include <plugin/Eigen/unsupported/Eigen/FFT>
 
 #include "functions.h"
 
@@ -145,6 +145,49 @@ double Fradiation(const VectorXd &vel, const VectorXd &irf, Eigen::Index iiter,
 	return Integral(cont, dt, SIMPSON_1_3);
 }	
 
+void RadiationConvolution::Init(const VectorXd &_vel, Eigen::Index _numIrf, double _dt) {
+	vel = _vel;
+	numIrf = _numIrf;
+	dt = _dt;
+	
+	nfft = 1;
+	while (nfft < vel.size() + numIrf)
+		nfft *= 2;
+	
+	VectorXd velPad = VectorXd::Zero(nfft);
+	velPad.head(vel.size()) = vel;
+	FFT<double> fft;
+	fft.fwd(velF, velPad);
+	
+	irfPad.setZero(nfft);
+	irfF.resize(nfft);
+	conv.resize(nfft);
+}
+
+// Same as Fradiation() for every iiter, with trapezoidal instead of Simpson integration
+void RadiationConvolution::Get(const VectorXd &irf, VectorXd &frad) {
+	ASSERT(irf.size() <= numIrf);
+	
+	Eigen::Index num = vel.size();
+	frad.setZero(num);
+	if (irf.size() == 0 || num < 2)
+		return;
+	
+	irfPad.setZero();
+	irfPad.head(irf.size()) = irf;
+	FFT<double> fft;
+	fft.fwd(irfF, irfPad);
+	irfF.array() *= velF.array();
+	fft.inv(conv, irfF);
+	
+	for (Eigen::Index i = 2; i < num; ++i) {
+		Eigen::Index n = min(i, irf.size());	// Σ irf(k)·vel(i-1-k), k = 0..n-1
+		if (n < 2)
+			continue;
+		frad(i) = dt*(conv(i-1) - 0.5*(irf(0)*vel(i-1) + irf(n-1)*vel(i-n)));
+	}
+}
+
 double DampedSin(double x, double z0, double zDecay, double mass, double ainf, double b, double w_d, double t0, double phi) {
 	double gamma = b/2/(mass + ainf);
 	return z0 + zDecay*exp(-gamma*(x-t0))*cos(w_d*(x-t0) + phi);
@@ -219,21 +262,25 @@ double FitToDampedSin(const VectorXd &y, double dt, double mass, double Kh, doub
 	return r2;
 }
 
-void Decay(double mass, double ainf, double av, double Kh, double b, double b2, double dt, double zDecay, double maxT, VectorXd &z ) {
-	Upp::Array<VectorXd> res, dres;
-	VectorXd y(2), dy(2);
-	y[0] = zDecay;
-	y[1] = dy[0] = 0;
-	dy[1] = -Kh*zDecay/(mass + ainf);
-	SolveDAE(y, dy, dt, maxT, res, dres, [&](double t, Eigen::Index iiter, const double y[], const double dy[], double residual[])->bool {
-		t = min(t, maxT);
-		int iter = int(maxT/dt);
-		res[1](iter) = y[1];
-		residual[0] = (mass + ainf + av*abs(y[1]))*dy[1] + Kh*y[0] + b*y[1] + b2*y[1]*abs(y[1]);
-		residual[1] = y[1] - dy[0];
-		return true;
-	});
-	z = pick(res[0]);	
+// Free decay of (mass + ainf + av|dz|)d2z + b·dz + b2·dz|dz| + Kh·z = 0, with RK4
+void Decay(double mass, double ainf, double av, double Kh, double b, double b2, double dt, double zDecay, double maxT, VectorXd &z) {
+	Eigen::Index num = Eigen::Index(maxT/dt) + 1;
+	z.resize(num);
+	
+	auto Acc = [&](double y, double v)->double {
+		return -(Kh*y + b*v + b2*v*abs(v))/(mass + ainf + av*abs(v));
+	};
+	double y = zDecay, v = 0;
+	z(0) = y;
+	for (Eigen::Index it = 1; it < num; ++it) {
+		double k1y = v,             k1v = Acc(y, v);
+		double k2y = v + dt/2*k1v,  k2v = Acc(y + dt/2*k1y, v + dt/2*k1v);
+		double k3y = v + dt/2*k2v,  k3v = Acc(y + dt/2*k2y, v + dt/2*k2v);
+		double k4y = v + dt*k3v,    k4v = Acc(y + dt*k3y,   v + dt*k3v);
+		y += dt/6*(k1y + 2*k2y + 2*k3y + k4y);
+		v += dt/6*(k1v + 2*k2v + 2*k3v + k4v);
+		z(it) = y;
+	}
 }
 
 void FitToDecay(const VectorXd &z, const VectorXd &dz, const VectorXd &d2z, 
@@ -261,6 +308,14 @@ void FitToDecay(const VectorXd &z, const VectorXd &dz, const VectorXd &d2z,
 		par.Bspl.resize(par.wspl.size());
 	}
 
+	const int numT = 1000;
+	RadiationConvolution conv;
+	conv.Init(dz, par.numB > 0 ? numT : par.Kirf.size(), dt);
+	
+	VectorXd frad, lastBdec;
+	if (par.numB == 0)						// Kirf is fixed, so radiation force is got only once
+		conv.Get(par.Kirf, frad);
+	
 	if (!NonLinearOptimization(coeff, z.size(), [&](const VectorXd &x, VectorXd &err)->int {
 		int idc = 0;
 		double ainf = abs(x[idc++]);
@@ -271,20 +326,21 @@ void FitToDecay(const VectorXd &z, const VectorXd &dz, const VectorXd &d2z,
 			for (int i = 0; i < par.numB-2; ++i)
 				par.Bdec(i+1) = abs(x[i+idc]);
 
-			par.splineB.Init(par.wdec, par.Bdec);
-			for (int i = 0; i < par.wspl.size(); ++i) 
-				par.Bspl(i) = par.splineB.f(par.wspl[i]);
-			
-			VectorXd Tirf;
-			double maxT = GetKirfMaxT(par.wspl);
-			int numT = 1000;
-			GetTirf(Tirf, numT, maxT);
-			GetKirf(par.Kirf, Tirf, par.wspl, par.Bspl);
-		}
-		for(Eigen::Index i = 0; i < z.size(); i++) {
-			double Frad = Fradiation(dz, par.Kirf, i, dt);
-			err[i] = (mass + ainf + av*abs(dz[i]))*d2z[i] + Frad + Kh*z[i] + b*dz[i] + b2*dz[i]*abs(dz[i]);
+			if (lastBdec.size() != par.Bdec.size() || lastBdec != par.Bdec) {	// Kirf and Frad are only updated if B changes
+				lastBdec = par.Bdec;
+				par.splineB.Init(par.wdec, par.Bdec);
+				for (int i = 0; i < par.wspl.size(); ++i) 
+					par.Bspl(i) = par.splineB.f(par.wspl[i]);
+				
+				VectorXd Tirf;
+				double maxT = GetKirfMaxT(par.wspl);
+				GetTirf(Tirf, numT, maxT);
+				GetKirf(par.Kirf, Tirf, par.wspl, par.Bspl);
+				conv.Get(par.Kirf, frad);
+			}
 		}
+		for(Eigen::Index i = 0; i < z.size(); i++) 
+			err[i] = (mass + ainf + av*abs(dz[i]))*d2z[i] + frad[i] + Kh*z[i] + b*dz[i] + b2*dz[i]*abs(dz[i]);
 		return true;	
 	}, Null, Null, 1000))
 		Cout() << "\nNLO problem";
@@ -296,10 +352,196 @@ void FitToDecay(const VectorXd &z, const VectorXd &dz, const VectorXd &d2z,
 	par.b2   = par.getb2 ? coeff[idc]   : 0;
 }
 
+static Upp::Vector<int> GetSortOrderX(const VectorXd &x) {
+	Upp::Vector<double> xx(int(x.size()));
+	for (int i = 0; i < xx.size(); ++i)
+		xx[i] = x(i);
+	return GetSortOrder(xx);
+}
+
+void Interpolator::Init(const VectorXd &x, const VectorXd &xnew, Type _type, bool clamp) {
+	type = _type;
+	Eigen::Index num = x.size();
+	ASSERT(num >= 2);
+	
+	order = GetSortOrderX(x);
+	VectorXd xs(num);
+	for (int i = 0; i < num; ++i)
+		xs(i) = x(order[i]);
+	hs = xs.tail(num-1) - xs.head(num-1);
+	
+	Upp::Vector<int> idnew = GetSortOrderX(xnew);
+	id.SetCount(int(xnew.size()));
+	t.resize(xnew.size());
+	for (int in = 0, k = 0; in < idnew.size(); ++in) {	// xnew is scanned in order, so brackets are found in one pass
+		int i = idnew[in];
+		double xx = xnew(i);
+		if (xx < xs(0) || xx > xs(num-1)) {
+			if (clamp) {
+				id[i] = xx < xs(0) ? 0 : int(num-2);
+				t(i)  = xx < xs(0) ? 0 : 1;
+			} else {
+				id[i] = -1;
+				t(i) = 0;
+			}
+			continue;
+		}
+		while (k < num-2 && xs(k+1) < xx)
+			k++;
+		id[i] = k;
+		t(i) = hs(k) > 0 ? (xx - xs(k))/hs(k) : 0;
+	}
+}
+
+// Values in intervals with a Null end are Null
+void Interpolator::Apply(const Eigen::Ref<const VectorXd> &y, Eigen::Ref<VectorXd> ynew) const {
+	ASSERT(y.size() == order.size() && ynew.size() == id.size());
+	
+	Eigen::Index num = y.size();
+	VectorXd ys(num);
+	for (int i = 0; i < num; ++i)
+		ys(i) = y(order[i]);
+	Upp::Vector<bool> valid(int(num-1));			// Interval without Null ends
+	for (int k = 0; k < num-1; ++k)
+		valid[k] = !IsNull(ys(k)) && !IsNull(ys(k+1));
+	
+	if (type == LINEAR) {
+		for (int i = 0; i < id.size(); ++i) {
+			int k = id[i];
+			ynew(i) = k < 0 || !valid[k] ? double(Null) : ys(k) + t(i)*(ys(k+1) - ys(k));
+		}
+		return;
+	}
+	
+	// Fritsch-Carlson slopes. Nodes next to a Null interval get the slope of the other one, as in the ends
+	VectorXd delta = VectorXd::Zero(num-1);
+	for (int k = 0; k < num-1; ++k)
+		if (valid[k])
+			delta(k) = (ys(k+1) - ys(k))/hs(k);
+	VectorXd m(num);
+	for (int k = 0; k < num; ++k) {
+		bool left = k > 0 && valid[k-1], right = k < num-1 && valid[k];
+		if (left && right)
+			m(k) = delta(k-1)*delta(k) <= 0 ? 0 : (delta(k-1) + delta(k))/2;
+		else
+			m(k) = left ? delta(k-1) : right ? delta(k) : 0;
+	}
+	for (Eigen::Index k = 0; k < num-1; ++k) {
+		if (!valid[int(k)])
+			continue;
+		if (delta(k) == 0) {
+			m(k) = m(k+1) = 0;
+			continue;
+		}
+		double a = m(k)/delta(k), b = m(k+1)/delta(k);
+		double r = a*a + b*b;
+		if (r > 9) {
+			double tau = 3/sqrt(r);
+			m(k) = tau*a*delta(k);
+			m(k+1) = tau*b*delta(k);
+		}
+	}
+	for (int i = 0; i < id.size(); ++i) {
+		int k = id[i];
+		if (k < 0 || !valid[k]) {
+			ynew(i) = Null;
+			continue;
+		}
+		double tt = t(i), t2 = tt*tt, t3 = t2*tt;
+		ynew(i) = (2*t3 - 3*t2 + 1)*ys(k) + (t3 - 2*t2 + tt)*hs(k)*m(k) + 
+				  (-2*t3 + 3*t2)*ys(k+1) + (t3 - t2)*hs(k)*m(k+1);
+	}
+}
+
+void Interpolator::Apply(const MatrixXd &y, MatrixXd &ynew) const {
+	ynew.resize(id.size(), y.cols());
+	for (Eigen::Index c = 0; c < y.cols(); ++c)
+		Apply(y.col(c), ynew.col(c));
+}
+
+void Interpolator::ApplyPhase(const Eigen::Ref<const VectorXd> &ph, Eigen::Ref<VectorXd> phnew) const {
+	ASSERT(ph.size() == order.size() && phnew.size() == id.size());
+	
+	for (int i = 0; i < id.size(); ++i) {
+		int k = id[i];
+		double ph0 = k < 0 ? double(Null) : ph(order[k]), ph1 = k < 0 ? double(Null) : ph(order[k+1]);
+		if (IsNull(ph0) || IsNull(ph1)) {
+			phnew(i) = Null;
+			continue;
+		}
+		double dph = remainder(ph1 - ph0, 2*M_PI);		// In [-π, π]
+		phnew(i) = remainder(ph0 + t(i)*dph, 2*M_PI);
+	}
+}
+
+void Interpolator::ApplyPhase(const MatrixXd &ph, MatrixXd &phnew) const {
+	phnew.resize(id.size(), ph.cols());
+	for (Eigen::Index c = 0; c < ph.cols(); ++c)
+		ApplyPhase(ph.col(c), phnew.col(c));
+}
+
 double FixHeading(double head) {
 	while (head < 0)
 		head += 360;
 	while (head >= 360)
 		head -= 360;
 	return head;
-}
\ No newline at end of file
+}
+
+// Headings ih0 and ih1 around hd, and the factor fh to interpolate between them, in a circle of 360 deg.
+// The interpolation only wraps at 360 deg if the headings cover the circle, so it returns false if hd is in
+// a gap much wider than the rest, as 270 deg when the headings are in [0, 180]
+bool GetHeadingBracket(const Upp::Vector<double> &heads, double hd, int &ih0, int &ih1, double &fh) {
+	double back = DBL_MAX, forward = DBL_MAX;		// Angles from ih0 to hd and from hd to ih1
+	ih0 = ih1 = -1;
+	for (int i = 0; i < heads.size(); ++i) {
+		double b = FixHeading(hd - heads[i]), f = FixHeading(heads[i] - hd);
+		if (b < back) {
+			back = b;
+			ih0 = i;
+		}
+		if (f < forward) {
+			forward = f;
+			ih1 = i;
+		}
+	}
+	if (ih0 < 0)
+		return false;
+	if (back == 0 || forward == 0) {
+		if (back != 0)
+			ih0 = ih1;
+		ih1 = ih0;
+		fh = 0;
+		return true;
+	}
+	fh = back/(back + forward);
+	
+	Upp::Vector<double> fixed;						// Widest gap between the other consecutive headings
+	for (double h : heads)
+		fixed << FixHeading(h);
+	Sort(fixed);
+	double maxGap = 0;
+	bool skipped = false;
+	for (int i = 0; i < fixed.size(); ++i) {
+		double gap = i < fixed.size()-1 ? fixed[i+1] - fixed[i] : fixed[0] + 360 - fixed[i];
+		if (gap == 0)
+			continue;
+		if (!skipped && abs(gap - (back + forward)) < 1E-6) {
+			skipped = true;							// The gap of hd
+			continue;
+		}
+		maxGap = max(maxGap, gap);
+	}
+	return back + forward <= 1.5*maxGap;
+}
+
+// JONSWAP wave spectrum [m²·s/rad]. It is Pierson-Moskowitz when gamma = 1
+double JONSWAP(double w, double Hs, double Tp, double gamma) {
+	if (w <= 0)
+		return 0;
+	double wp = 2*M_PI/Tp;
+	double sigma = w <= wp ? 0.07 : 0.09;
+	double Agamma = 1 - 0.287*log(gamma);
+	double Spm = 5./16*sqr(Hs)*pow(wp, 4)*pow(w, -5)*exp(-5./4*pow(w/wp, -4));
+	return Agamma*Spm*pow(gamma, exp(-sqr(w - wp)/(2*sqr(sigma*wp))));
+}
@@ -20,6 +20,20 @@ void GetA(Eigen::VectorXd &A, const Eigen::VectorXd &Kirf, const Eigen::VectorXd
 //double Fradiation2(double t, const Eigen::VectorXd &vel, const Eigen::VectorXd &irf, double dt);
 double Fradiation(const Eigen::VectorXd &vel, const Eigen::VectorXd &irf, Eigen::Index iiter, double dt, Eigen::Index velSize = -1);
 
+// Radiation memory force for all the time steps of a velocity series, by FFT convolution.
+// Velocity spectrum and buffers are kept between calls, so only irf changes are processed
+class RadiationConvolution {
+public:
+	void Init(const Eigen::VectorXd &vel, Eigen::Index numIrf, double dt);
+	void Get(const Eigen::VectorXd &irf, Eigen::VectorXd &frad);
+	
+private:
+	Eigen::VectorXd vel, irfPad, conv;
+	Eigen::VectorXcd velF, irfF;
+	Eigen::Index nfft = 0, numIrf = 0;
+	double dt = 0;
+};
+
 struct ParamDampedSin {
 	double z0,
 		   zDecay, 
@@ -82,6 +96,32 @@ void FitToDecay(const Eigen::VectorXd &z, const Eigen::VectorXd &dz, const Eigen
 			double dt, double mass, double Kh, double g, ParamDecay &param);
 void Decay(double mass, double ainf, double av, double Kh, double b, double b2, double dt, double zDecay, double maxT, Eigen::VectorXd &z);
 
+// Interpolation tables from x to xnew. Brackets and weights are got once in Init(), and then applied
+// to any number of series. Points outside x are set to Null, or to the closest end if clamp
+class Interpolator {
+public:
+	enum Type {LINEAR, CUBIC};		// CUBIC is monotone piecewise cubic Hermite (Fritsch-Carlson)
+	
+	void Init(const Eigen::VectorXd &x, const Eigen::VectorXd &xnew, Type type = LINEAR, bool clamp = false);
+	
+	void Apply(const Eigen::Ref<const Eigen::VectorXd> &y, Eigen::Ref<Eigen::VectorXd> ynew) const;
+	void Apply(const Eigen::MatrixXd &y, Eigen::MatrixXd &ynew) const;			// By columns
+	void ApplyPhase(const Eigen::Ref<const Eigen::VectorXd> &ph, Eigen::Ref<Eigen::VectorXd> phnew) const;	// rad. Shortest arc
+	void ApplyPhase(const Eigen::MatrixXd &ph, Eigen::MatrixXd &phnew) const;
+	
+	Eigen::Index GetCount() const	{return id.size();}
+	
+private:
+	Type type;
+	Upp::Vector<int> order;			// Sort order of x
+	Upp::Vector<int> id;			// Bracket in sorted x. -1 if outside
+	Eigen::VectorXd t;				// Local coordinate in the bracket [0, 1]
+	Eigen::VectorXd hs;				// Sorted x intervals
+};
+
 double FixHeading(double head);
+bool GetHeadingBracket(const Upp::Vector<double> &heads, double hd, int &ih0, int &ih1, double &fh);
+
+double JONSWAP(double w, double Hs, double Tp, double gamma = 3.3);
 		
 #endif
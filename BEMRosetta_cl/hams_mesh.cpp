@@ -3,8 +3,8 @@
 
 
 String MeshData::LoadPnlHAMS(String fileName, bool &y0z, bool &x0z) {
-	FileInLine in(fileName);
-	if (!in.IsOpen()) 
+	MeshScan in;
+	if (!in.Open(fileName)) 
 		return Format(t_("Impossible to open file '%s'"), fileName);
 	
 	this->fileName = fileName;
@@ -12,113 +12,70 @@ String MeshData::LoadPnlHAMS(String fileName, bool &y0z, bool &x0z) {
 	
 	mesh.Clear();
 	
-	FieldSplit f(in);	
-	f.IsSeparator = IsTabSpace;
-		
 	Index<int> ids;
 	try {
-		String line;
-		line = in.GetLine();	
-		
-		if (line.Find("Mesh File") < 0)
+		if (!in.LineContains("Mesh File"))
 			return t_("Format error in HAMS .pnl mesh file");	// To detect HAMS format
 
-		bool done = false;
-		while(!in.IsEof()) {
-			line = in.GetLine();
-			
-			if (line.Find("Number of Panels") >= 0) {
-				done = true;
-				break;
-			}
-		}
-		if (!done)
+		if (!in.FindLine("Number of Panels"))
 			throw Exc(t_("Format error in HAMS .dat mesh file. Number of Panels, Nodes, X-Symmetry and Y-Symmetry not found"));
 		
-		f.Load(in.GetLine());
-		//int numPanels = f.GetInt(0);
-		//int numNodes = f.GetInt(1);
-		y0z = f.GetInt(2) == 1;
-		x0z = f.GetInt(3) == 1;
-		
-		done = false;
-		while(!in.IsEof()) {
-			line = in.GetLine();
-			
-			if (line.Find("Start Definition of Node Coordinates") >= 0) {
-				done = true;
-				break;
-			}
+		int numPanels = in.GetInt();
+		int numNodes = in.GetInt();
+		y0z = in.GetInt() == 1;
+		x0z = in.GetInt() == 1;
+		in.NextLine();
+		if (numPanels > 0)
+			mesh.panels.Reserve(numPanels);
+		if (numNodes > 0) {
+			mesh.nodes.Reserve(numNodes);
+			ids.Reserve(numNodes);
 		}
-		if (!done)
+		
+		if (!in.FindLine("Start Definition of Node Coordinates"))
 			throw Exc(t_("Format error in HAMS .dat mesh file. Start Definition of Node Coordinates not found"));
 		
-		done = false;
+		bool done = false;
 		while(!in.IsEof()) {
-			line = in.GetLine();
-			
-			if (line.Find("End") >= 0) {
+			if (in.LineContains("End")) {
+				in.NextLine();
 				done = true;
 				break;
-			} else {
-				f.Load(line);
-				ids << f.GetInt(0);
+			} else if (!in.IsEol()) {
+				ids << in.GetInt();
 				Point3D &node = mesh.nodes.Add();
-				node.x = f.GetDouble(1);
-				node.y = f.GetDouble(2);
-				node.z = f.GetDouble(3);
+				node.x = in.GetDouble();
+				node.y = in.GetDouble();
+				node.z = in.GetDouble();
 			} 
+			in.NextLine();
 		}
 		if (!done)
 			throw Exc(t_("Format error in HAMS .dat mesh file. Points list End not found"));
 		
-		done = false;
-		while(!in.IsEof()) {
-			line = in.GetLine();
-			
-			if (line.Find("Start Definition of Node Relations") >= 0) {
-				done = true;
-				break;
-			}
-		}
-		if (!done)
+		if (!in.FindLine("Start Definition of Node Relations"))
 			throw Exc(t_("Format error in HAMS .dat mesh file. Start Definition of Node Relations not found"));		
 		
 		done = false;
 		while(!in.IsEof()) {
-			line = in.GetLine();
-			
-			 if (line.Find("End") > 0) {
+			if (in.LineContains("End")) {
 				done = true;
 				break;
-			} else {
-				f.Load(line);
-				
-				int numVert = f.GetInt(1);
+			} else if (!in.IsEol()) {
+				in.GetInt();
+				int numVert = in.GetInt();
 
 				Panel &panel = mesh.panels.Add();
-				int id;
-				id = f.GetInt(2);
-				if ((id = ids.Find(id)) < 0)
-					throw Exc(in.Str() + "\n"  + t_("id 1 not found"));
-				panel.id[0] = id;
-				id = f.GetInt(3);
-				if ((id = ids.Find(id)) < 0)
-					throw Exc(in.Str() + "\n"  + t_("id 2 not found"));
-				panel.id[1] = id;
-				id = f.GetInt(4);
-				if ((id = ids.Find(id)) < 0)
-					throw Exc(in.Str() + "\n"  + t_("id 3 not found"));
-				panel.id[2] = id;
-					
-				if (numVert == 4) {
-					id = f.GetInt(5);
-					if ((id = ids.Find(id)) < 0)
-						throw Exc(in.Str() + "\n"  + t_("id 4 not found"));
-					panel.id[3] = id;
-				} else if (numVert == 3) 
+				for (int i = 0; i < numVert && i < 4; ++i) {
+					int id = ids.Find(in.GetInt());
+					if (id < 0)
+						throw Exc(in.Str() + "\n"  + Format(t_("id %d not found"), i+1));
+					panel.id[i] = id;
+				}
+				if (numVert == 3) 
 					panel.id[3] = panel.id[0];
 			}
+			in.NextLine();
 		}
 		if (!done)
 			throw Exc(t_("Format error in HAMS .pnl mesh file. Panels list End not found"));
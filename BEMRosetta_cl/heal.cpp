@@ -203,17 +203,22 @@ void HealBEM::Save(const VectorXd &w, VectorXd &A, VectorXd &Ainfw, double &ainf
 	Kirf = this->fKirf;
 	ainf = this->fainf;
 	
-	for (int iw = 0; iw < w.size(); ++iw) {
-		A(iw)  = LinearInterpolate(w[iw], this->w, this->A);
-		Ainfw(iw) = LinearInterpolate(w[iw], this->w, this->fAinf);
-		B(iw)  = LinearInterpolate(w[iw], this->w, this->B);
-	}	
+	A.resize(w.size());
+	Ainfw.resize(w.size());
+	B.resize(w.size());
+	
+	Interpolator lin;
+	lin.Init(this->w, w, Interpolator::LINEAR, true);
+	lin.Apply(this->fA, A);
+	lin.Apply(this->fAinf, Ainfw);
+	lin.Apply(this->fB, B);
 }
 	
-void HealBEM::Heal() {
+void HealBEM::Heal(double srate) {
 	// Removes NaN, Inf, duplicated (or nearly) w, sorts by w 
 	CleanNANDupXSort(w, A, B, w, A, B);
-	double srate = GetSampleRate(w, 4, .8);	// Gets the most probable sample rate, or the average if the most probable probability is lower than 0.8
+	if (IsNull(srate))	// Gets the most probable sample rate, or the average if the most probable probability is lower than 0.8
+		srate = GetSampleRate(w, 4, .8);	
 	Resample(w, A, B, w, A, B, srate);	
 	
 	
@@ -445,27 +450,137 @@ void HealBEM::Heal() {
 				ScrimTape(w, fB, idaoixMx-3, idaoixMx+3);	// Scrimtape to fix the patch +- 3 points around
 	 		}
 		}
+	}
+	
+	// Interval to get Ainf
+	int fromA;
+	for (int i = 0; i < w.size() && w[fromA = i] < 0.1*aoidx; ++i) 	// From 0.1*aoidx
+	 	;
+	int toA = max(idaoiyMx, fromA + 1);								// To the max value idaoiyMx
+	
+	
+	// IRF and Ainf obtained from filtered B fB. A used directly (should it be softly
+	// filtered?
+	GetTirf(Tirf, numT, maxT);
+	GetKirf(fKirf, Tirf, w, fB);
+	GetAinfw(fAinf, fKirf, Tirf, w, A);
+	
+	VectorXd tmp = fAinf.segment(fromA, toA-fromA);
+	fainf = tmp.mean();		// New clean Ainf
+	
+	double dt = maxT/(numT-1);
+	// New fA obtained from ainf and fB
+	GetA(fA, fKirf, w, fainf, dt);
+}
 
-		// Interval to get Ainf
-		int fromA;
-		for (int i = 0; i < w.size() && w[fromA = i] < 0.1*aoidx; ++i) 	// From 0.1*aoidx
-		 	;
-		int toA = idaoiyMx;												// To the max value idaoiyMx
-		
-		
-		// IRF and Ainf obtained from filtered B fB. A used directly (should it be softly
-		// filtered?
-		GetTirf(Tirf, numT, maxT);
-		GetKirf(fKirf, Tirf, w, fB);
-		GetAinfw(fAinf, fKirf, Tirf, w, A);
-		
-		VectorXd tmp = fAinf.segment(fromA, toA-fromA);
-		fainf = tmp.mean();		// New clean Ainf
-		
-		double dt = maxT/(numT-1);
-		// New fA obtained from ainf and fB
-		GetA(fA, fKirf, w, fainf, dt);
+// Heals all the available DOF pairs in parallel. All of them share the same frequency grid,
+// so the sample rate is obtained only once
+bool Hydro::Heal(Function <bool(String, int)> Status) {
+	if (!IsLoadedA() || !IsLoadedB()) {
+		lastError = t_("A and B are required to heal the coefficients");
+		return false;
+	}
+	if (Nf < 4) {
+		lastError = t_("Not enough frequencies to heal the coefficients");
+		return false;
+	}
+	if (IsNull(bem->maxTimeA) || bem->maxTimeA == 0 || IsNull(bem->numValsA) || bem->numValsA < 10) {
+		lastError = t_("Incorrect time data for A∞ calculation. Please review it in Options");
+		return false;
+	}
+	
+	// Pairs without radiation damping, as the all zero coupled DOF written by the solvers, 
+	// have no area of interest to heal. They are left as they are
+	Upp::Vector<int> idfs, jdfs;
+	for (int idf = 0; idf < 6*Nb; ++idf) 
+		for (int jdf = 0; jdf < 6*Nb; ++jdf) 
+			if (!IsNull(A[idf][jdf][0]) && !IsNull(B[idf][jdf][0]) && B[idf][jdf].sum() > 0) {
+				idfs << idf;
+				jdfs << jdf;
+			}
+	if (idfs.IsEmpty()) {
+		lastError = t_("No DOF available to heal");
+		return false;
 	}
+	
+	if (!Status(Format(t_("Healing %d DOF pairs"), idfs.size()), 10)) {
+		lastError = t_("Cancelled by user");
+		return false;
+	}
+	
+	VectorXd ww = Get_w();
+	double srate = GetSampleRate(ww, 4, .8);
+	double maxT = min(bem->maxTimeA, GetK_IRF_MaxT());
+	int numT = bem->numValsA;
+	
+	// Kirf of the pairs not healed is kept if it has the same time grid
+	VectorXd tirf;
+	GetTirf(tirf, numT, maxT);
+	bool sameT = Tirf.size() == tirf.size() && Tirf.isApprox(tirf);
+	
+	if (!IsLoadedAwinf())
+		Awinf.setConstant(Nb*6, Nb*6, Null);
+	Kirf.SetCount(Nb*6);
+	for (int i = 0; i < Nb*6; ++i) {
+		Kirf[i].SetCount(Nb*6);
+		for (int j = 0; j < Nb*6; ++j)
+			if (!sameT || Kirf[i][j].size() != numT)
+				Kirf[i][j].setConstant(numT, Null);
+	}
+	Tirf = tirf;
+	if (Ainfw.size() != Nb*6) {
+		Ainfw.SetCount(Nb*6);
+		for (int i = 0; i < Nb*6; ++i) {
+			Ainfw[i].SetCount(Nb*6);
+			for (int j = 0; j < Nb*6; ++j)
+				Ainfw[i][j].setConstant(Nf, Null);
+		}
+	}
+	
+	// Status is called from this thread while the pairs are healed
+	int num = idfs.size();
+	std::atomic<int> done(0);
+	bool cancelled = false;
+	try {
+		CoWork co;
+		for (int ip = 0; ip < num; ++ip) {
+			co & [&, ip] {
+				if (CoWork::IsCanceled())
+					return;
+				int idf = idfs[ip], jdf = jdfs[ip];
+				HealBEM heal;
+				heal.Load(ww, A[idf][jdf], B[idf][jdf], maxT, numT);
+				heal.Heal(srate);
+				VectorXd tirfPair;
+				heal.Save(ww, A[idf][jdf], Ainfw[idf][jdf], Awinf(idf, jdf), B[idf][jdf], tirfPair, Kirf[idf][jdf]);
+				done++;
+			};
+		}
+		int reported = 0;
+		while (!co.IsFinished()) {
+			int d = done;
+			if (d > reported) {
+				reported = d;
+				if (!Status(Format(t_("Healed %d of %d DOF pairs"), d, num), 10 + (90*d)/num)) {
+					co.Cancel();
+					cancelled = true;
+					break;
+				}
+			}
+			Sleep(10);
+		}
+		co.Finish();
+	} catch (Exc e) {
+		lastError = e;
+		return false;
+	}
+	if (cancelled) {
+		lastError = t_("Cancelled by user");
+		return false;
+	}
+	
+	Status(t_("Coefficients healed"), 100);
+	return true;
 }
 
  
@@ -3,7 +3,7 @@
 
 class HealBEM {
 public:
-	void Heal();
+	void Heal(double srate = Null);
 	void Load(const VectorXd &w, const VectorXd &A, const VectorXd &B, double maxT, int num);
 	void Save(const VectorXd &w, VectorXd &A, VectorXd &Ainfw, double &ainf, VectorXd &B, 
 				VectorXd &Tirf, VectorXd &Kinf);
@@ -0,0 +1,315 @@
+#include "BEMRosetta.h"
+
+using namespace Eigen;
+
+// Index of p_a·p_b in the moments basis 1, x, y, z, x², y², z², xy, xz, yz
+static inline int Quad(int a, int b) {
+	return a == b ? 4 + a : 6 + a + b;
+}
+
+static void Basis(double x, double y, double z, double b[10]) {
+	b[0] = 1;
+	b[1] = x;	b[2] = y;	b[3] = z;
+	b[4] = x*x;	b[5] = y*y;	b[6] = z*z;
+	b[7] = x*y;	b[8] = x*z;	b[9] = y*z;
+}
+
+void MeshData::Hydrostatics::Moments::Add(const Moments &mom, double sign) {
+	area += sign*mom.area;
+	for (int f = 0; f < 10; ++f)
+		for (int k = 0; k < 3; ++k)
+			m[f][k] += sign*mom.m[f][k];
+}
+
+// Quadratic functions are integrated exactly with the mean of the edge midpoints
+void MeshData::Hydrostatics::Moments::AddTriangle(const Point3D &a, const Point3D &b, const Point3D &c, double sign) {
+	// N = 2·area·normal
+	double ux = b.x - a.x, uy = b.y - a.y, uz = b.z - a.z;
+	double vx = c.x - a.x, vy = c.y - a.y, vz = c.z - a.z;
+	double N[3] = {uy*vz - uz*vy, uz*vx - ux*vz, ux*vy - uy*vx};
+
+	double b0[10], b1[10], b2[10];
+	Basis((a.x + b.x)/2, (a.y + b.y)/2, (a.z + b.z)/2, b0);
+	Basis((b.x + c.x)/2, (b.y + c.y)/2, (b.z + c.z)/2, b1);
+	Basis((c.x + a.x)/2, (c.y + a.y)/2, (c.z + a.z)/2, b2);
+
+	area += sign*sqrt(N[0]*N[0] + N[1]*N[1] + N[2]*N[2])/2;
+	for (int f = 0; f < 10; ++f) {
+		double mean = sign*(b0[f] + b1[f] + b2[f])/6;		// /3 for the mean and /2 for N
+		for (int k = 0; k < 3; ++k)
+			m[f][k] += mean*N[k];
+	}
+}
+
+// Adds the part of the triangle below z = 0, as one or two triangles
+void MeshData::Hydrostatics::Moments::AddTriangleUnder(const Point3D &a, const Point3D &b, const Point3D &c) {
+	if (a.z <= 0 && b.z <= 0 && c.z <= 0) {
+		AddTriangle(a, b, c);
+		return;
+	}
+	if (a.z >= 0 && b.z >= 0 && c.z >= 0)
+		return;
+
+	const Point3D *p[3] = {&a, &b, &c};
+	Point3D poly[4];
+	int num = 0;
+	for (int i = 0; i < 3; ++i) {
+		const Point3D &p0 = *p[i], &p1 = *p[(i+1)%3];
+		if (p0.z <= 0)
+			poly[num++] = p0;
+		if ((p0.z < 0 && p1.z > 0) || (p0.z > 0 && p1.z < 0)) {
+			double t = p0.z/(p0.z - p1.z);
+			poly[num++] = Point3D(p0.x + t*(p1.x - p0.x), p0.y + t*(p1.y - p0.y), 0);
+		}
+	}
+	for (int i = 1; i < num-1; ++i)
+		AddTriangle(poly[0], poly[i], poly[i+1]);
+}
+
+void MeshData::Hydrostatics::Moments::AddPanel(const MeshSoA &soa, int ip, double sign) {
+	Point3D p0 = soa.GetPanelNode(ip, 0), p2 = soa.GetPanelNode(ip, 2);
+	AddTriangle(p0, soa.GetPanelNode(ip, 1), p2, sign);
+	if (!soa.IsTriangle(ip))
+		AddTriangle(p0, p2, soa.GetPanelNode(ip, 3), sign);
+}
+
+void MeshData::Hydrostatics::Moments::AddPanelUnder(const MeshSoA &soa, int ip) {
+	Point3D p0 = soa.GetPanelNode(ip, 0), p2 = soa.GetPanelNode(ip, 2);
+	AddTriangleUnder(p0, soa.GetPanelNode(ip, 1), p2);
+	if (!soa.IsTriangle(ip))
+		AddTriangleUnder(p0, p2, soa.GetPanelNode(ip, 3));
+}
+
+// Vectorized AddTriangle() over arrays of triangles a, b, c, added to full and, weighted by w, to part.
+// Degenerated triangles, like the second half of triangular panels, add nothing
+void MeshData::Hydrostatics::Moments::AddTriangles(const ArrayXd a[3], const ArrayXd b[3], const ArrayXd c[3],
+											const ArrayXd &w, Moments &full, Moments &part) {
+	ArrayXd u[3], v[3], mid[3][3];
+	for (int i = 0; i < 3; ++i) {
+		u[i] = b[i] - a[i];
+		v[i] = c[i] - a[i];
+		mid[0][i] = (a[i] + b[i])/2;
+		mid[1][i] = (b[i] + c[i])/2;
+		mid[2][i] = (c[i] + a[i])/2;
+	}
+	ArrayXd N[3] = {u[1]*v[2] - u[2]*v[1], u[2]*v[0] - u[0]*v[2], u[0]*v[1] - u[1]*v[0]};
+	ArrayXd wN[3] = {w*N[0], w*N[1], w*N[2]};
+
+	ArrayXd len = (N[0].square() + N[1].square() + N[2].square()).sqrt();
+	full.area += len.sum()/2;
+	part.area += (w*len).sum()/2;
+
+	ArrayXd mean;
+	for (int f = 0; f < 10; ++f) {
+		// /3 for the mean and /2 for N
+		if (f == 0)
+			mean = ArrayXd::Constant(len.size(), 1./2);
+		else if (f < 4)
+			mean = (mid[0][f-1] + mid[1][f-1] + mid[2][f-1])/6;
+		else {
+			static const int ij[6][2] = {{0, 0}, {1, 1}, {2, 2}, {0, 1}, {0, 2}, {1, 2}};
+			int i = ij[f-4][0], j = ij[f-4][1];
+			mean = (mid[0][i]*mid[0][j] + mid[1][i]*mid[1][j] + mid[2][i]*mid[2][j])/6;
+		}
+		for (int k = 0; k < 3; ++k) {
+			full.m[f][k] += (mean*N[k]).sum();
+			part.m[f][k] += (mean*wN[k]).sum();
+		}
+	}
+}
+
+// Moments after moving the surface as p' = R·p + t, with n' = R·n and the same area.
+// ∫f(p')·n' dS is got expanding f(R·p + t) in the basis
+void MeshData::Hydrostatics::Moments::Transform(const Matrix3d &R, const Vector3d &t) {
+	double P[10][10] = {};
+	P[0][0] = 1;
+	for (int i = 0; i < 3; ++i) {
+		P[1+i][0] = t(i);
+		for (int j = 0; j < 3; ++j)
+			P[1+i][1+j] = R(i, j);
+	}
+	for (int i = 0; i < 3; ++i) {
+		for (int j = i; j < 3; ++j) {
+			double *Pq = P[Quad(i, j)];
+			for (int a = 0; a < 3; ++a)
+				for (int b = 0; b < 3; ++b)
+					Pq[Quad(a, b)] += R(i, a)*R(j, b);
+			for (int b = 0; b < 3; ++b)
+				Pq[1+b] += t(i)*R(j, b) + t(j)*R(i, b);
+			Pq[0] += t(i)*t(j);
+		}
+	}
+	double mr[10][3];
+	for (int f = 0; f < 10; ++f) {
+		for (int k = 0; k < 3; ++k) {
+			double val = 0;
+			for (int j = 0; j < 10; ++j) {
+				double mRj = 0;
+				for (int l = 0; l < 3; ++l)
+					mRj += m[j][l]*R(k, l);
+				val += P[f][j]*mRj;
+			}
+			mr[f][k] = val;
+		}
+	}
+	memcpy(m, mr, sizeof(m));
+}
+
+// Panels are processed in parallel in blocks of fixed size, whose partial sums are added in order,
+// so results do not depend on the number of threads
+static const int blockSize = 4096;
+
+static int GetNumBlocks(const MeshSoA &soa) {
+	return (soa.GetPanelCount() + blockSize - 1)/blockSize;
+}
+
+// Gathers the nodes of the block panels, and gets per panel -1 if it is submerged,
+// 1 if it is dry and 0 if it crosses the water line
+static void GetBlock(const MeshSoA &soa, int from, int to, ArrayXd p[4][3], ArrayXi &side) {
+	for (int j = 0; j < 4; ++j)
+		soa.GetPanelNodes(from, to, j, p[j][0], p[j][1], p[j][2]);
+	ArrayXd zmin = p[0][2].min(p[1][2]).min(p[2][2]).min(p[3][2]);
+	ArrayXd zmax = p[0][2].max(p[1][2]).max(p[2][2]).max(p[3][2]);
+	side = (zmax <= 0).select(ArrayXi::Constant(to - from, -1), (zmin >= 0).cast<int>());
+}
+
+// All the integrals in a single pass
+void MeshData::Hydrostatics::Get(const MeshSoA &soa) {
+	BEM_PROFILE("MeshData::Hydrostatics::Get");
+
+	int numPanels = soa.GetPanelCount();
+	int numBlocks = GetNumBlocks(soa);
+	Upp::Array<Moments> pfull(numBlocks), pwet(numBlocks), pcut(numBlocks);
+	side.SetCount(numPanels);
+
+	CoWork co;
+	for (int ib = 0; ib < numBlocks; ++ib)
+		co & [&, ib] {
+			int from = ib*blockSize, to = min(numPanels, from + blockSize);
+			ArrayXd p[4][3];
+			ArrayXi bside;
+			GetBlock(soa, from, to, p, bside);
+			
+			// Quads as triangles 0, 1, 2 and 0, 2, 3
+			ArrayXd w = (bside < 0).cast<double>();
+			Moments::AddTriangles(p[0], p[1], p[2], w, pfull[ib], pwet[ib]);
+			Moments::AddTriangles(p[0], p[2], p[3], w, pfull[ib], pwet[ib]);
+			
+			for (int i = 0; i < to - from; ++i) {
+				side[from + i] = bside(i);
+				if (bside(i) == 0)
+					pcut[ib].AddPanelUnder(soa, from + i);
+			}
+		};
+	co.Finish();
+
+	full = wet = Moments();
+	numMoves = 0;
+	Moments cut;
+	for (int ib = 0; ib < numBlocks; ++ib) {
+		full.Add(pfull[ib]);
+		wet.Add(pwet[ib]);
+		cut.Add(pcut[ib]);
+	}
+	Update(cut);
+}
+
+// Updates the integrals after nodes have been moved as a rigid body as p' = R·p + t.
+// Moments of the full surface and of the submerged panels are transformed analytically,
+// so only the panels that cross the water line, or that enter or leave the water, are integrated.
+// Every maxMoves moves all is integrated again
+void MeshData::Hydrostatics::Move(const MeshSoA &soa, const Matrix3d &R, const Vector3d &t) {
+	BEM_PROFILE("MeshData::Hydrostatics::Move");
+
+	int numPanels = soa.GetPanelCount();
+	if (side.size() != numPanels || ++numMoves > maxMoves) {		// Rounding errors are not accumulated
+		Get(soa);
+		return;
+	}
+	full.Transform(R, t);
+	wet.Transform(R, t);
+
+	int numBlocks = GetNumBlocks(soa);
+	Upp::Array<Moments> pdelta(numBlocks), pcut(numBlocks);
+
+	CoWork co;
+	for (int ib = 0; ib < numBlocks; ++ib)
+		co & [&, ib] {
+			int from = ib*blockSize, to = min(numPanels, from + blockSize);
+			ArrayXd p[4][3];
+			ArrayXi bside;
+			GetBlock(soa, from, to, p, bside);
+			
+			for (int i = 0; i < to - from; ++i) {
+				int ip = from + i;
+				int8 sideNew = bside(i);
+				if (side[ip] < 0 && sideNew >= 0)
+					pdelta[ib].AddPanel(soa, ip, -1);
+				else if (side[ip] >= 0 && sideNew < 0)
+					pdelta[ib].AddPanel(soa, ip);
+				if (sideNew == 0)
+					pcut[ib].AddPanelUnder(soa, ip);
+				side[ip] = sideNew;
+			}
+		};
+	co.Finish();
+
+	Moments cut;
+	for (int ib = 0; ib < numBlocks; ++ib) {
+		wet.Add(pdelta[ib]);
+		cut.Add(pcut[ib]);
+	}
+	Update(cut);
+}
+
+// Gets the values from the moments. The lid closing the underwater surface has ∫f·nz dS = -∫wet f·nz dS
+void MeshData::Hydrostatics::Update(const Moments &cut) {
+	Moments under = wet;
+	under.Add(cut);
+
+	surface = full.area;
+	volumex = full.m[1][0];
+	volumey = full.m[2][1];
+	volumez = full.m[3][2];
+
+	underSurface = under.area;
+	underVolumex = under.m[1][0];
+	underVolumey = under.m[2][1];
+	underVolumez = under.m[3][2];
+	momx = under.m[8][2];
+	momy = under.m[9][2];
+	momz = under.m[6][2]/2;
+
+	wpArea = -under.m[0][2];
+	wpx  = -under.m[1][2];
+	wpy  = -under.m[2][2];
+	wpxx = -under.m[4][2];
+	wpyy = -under.m[5][2];
+	wpxy = -under.m[7][2];
+}
+
+Point3D MeshData::Hydrostatics::GetCb() const {
+	double vol = GetUnderVolume();
+	if (vol == 0)
+		return Point3D(Null, Null, Null);
+	return Point3D(momx/vol, momy/vol, momz/vol);
+}
+
+// Hydrostatic stiffness around the origin as in WAMIT
+void MeshData::Hydrostatics::GetC(MatrixXd &C, double rho, double g, const Point3D &cg, double mass) const {
+	double rho_g = rho*g;
+	double vol = GetUnderVolume();
+	Point3D cb = GetCb();
+
+	C.setConstant(6, 6, 0);
+	if (vol == 0)
+		return;
+	C(2, 2) = rho_g*wpArea;
+	C(2, 3) = C(3, 2) = rho_g*wpy;
+	C(2, 4) = C(4, 2) = -rho_g*wpx;
+	C(3, 3) = rho_g*(wpyy + vol*cb.z) - mass*g*cg.z;
+	C(3, 4) = C(4, 3) = -rho_g*wpxy;
+	C(3, 5) = -rho_g*vol*cb.x + mass*g*cg.x;
+	C(4, 4) = rho_g*(wpxx + vol*cb.z) - mass*g*cg.z;
+	C(4, 5) = -rho_g*vol*cb.y + mass*g*cg.y;
+}
@@ -0,0 +1,198 @@
+#include "BEMRosetta.h"
+
+// Cache of loaded meshes, with the panel parameters, limits, underwater mesh and water line, and hydrostatic moments
+// got in AfterLoad(). A cache file is used only if the mesh file path, length, time and load options match.
+// Stiffness and derived values are got again, as they depend on rho, g, cg and mass.
+// When the folder is bigger than cacheMaxSize, the least recently used files are deleted
+
+static const int cacheVersion = 3;
+
+int64 MeshData::cacheMaxSize = int64(500) << 20;
+
+static StaticMutex cacheMutex;
+static int64 cacheSize = -1;		// Size of the cache files. -1 until the folder is scanned
+
+struct MeshCacheKey {
+	String file;
+	int64 length = 0;
+	Time time;
+	bool cleanPanels = false;
+	int sizes[5] = {sizeof(Point3D), sizeof(Panel), sizeof(Segment3D), sizeof(Surface::env), sizeof(MeshData::Hydrostatics::Moments)};	// Raw data layout
+
+	MeshCacheKey() {}
+	MeshCacheKey(String fileName, bool _cleanPanels) {
+		file = NormalizePath(fileName);
+		length = GetFileLength(file);
+		time = FileGetTime(file);
+		cleanPanels = _cleanPanels;
+	}
+	void Serialize(Stream &s) {
+		int version = cacheVersion;
+		s / version;
+		if (version != cacheVersion)
+			s.LoadError();
+		s % file % length % time % cleanPanels;
+		for (int &size : sizes)
+			s / size;
+	}
+	bool operator==(const MeshCacheKey &key) const {
+		return file == key.file && length == key.length && time == key.time && cleanPanels == key.cleanPanels
+			&& memcmp(sizes, key.sizes, sizeof(sizes)) == 0;
+	}
+};
+
+template <class T>
+static void SerializeRaw(Stream &s, Upp::Vector<T> &data) {
+	int num = data.size();
+	s / num;
+	if (s.IsLoading()) {
+		if (num < 0 || int64(num)*sizeof(T) > s.GetLeft())
+			s.LoadError();
+		data.SetCount(num);
+	}
+	s.SerializeRaw((byte *)data.begin(), int64(num)*sizeof(T));
+}
+
+static void SerializeSurface(Stream &s, Surface &surf) {
+	SerializeRaw(s, surf.nodes);
+	SerializeRaw(s, surf.panels);
+	SerializeRaw(s, surf.segWaterlevel);
+	s.SerializeRaw((byte *)&surf.env, sizeof(surf.env));
+}
+
+void MeshData::Hydrostatics::Serialize(Stream &s) {
+	s % surface % volumex % volumey % volumez
+	  % underSurface % underVolumex % underVolumey % underVolumez
+	  % momx % momy % momz
+	  % wpArea % wpx % wpy % wpxx % wpyy % wpxy;
+	s.SerializeRaw((byte *)&full, sizeof(full));
+	s.SerializeRaw((byte *)&wet, sizeof(wet));
+	SerializeRaw(s, side);
+	if (s.IsLoading())
+		numMoves = 0;
+}
+
+void MeshData::SerializeCache(Stream &s, bool &y0z, bool &x0z) {
+	int icode = code;
+	s % icode % y0z % x0z % header;
+	code = MESH_FMT(icode);
+	SerializeSurface(s, mesh);
+	SerializeSurface(s, under);
+	s % hs;
+}
+
+String MeshData::GetCacheFileName(String fileName) {
+	return AppendFileName(GetCacheFolder(), SHA1String(NormalizePath(fileName)) + ".bmc");
+}
+
+// Loads the mesh from its cache. Returns false if there is no valid cache for it
+bool MeshData::LoadCache(String fileName, bool cleanPanels, bool &y0z, bool &x0z) {
+	BEM_PROFILE("MeshData::LoadCache");
+
+	if (cacheMaxSize == 0)
+		return false;
+	String cacheFile = GetCacheFileName(fileName);
+	FileIn in(cacheFile);
+	if (!in.IsOpen())
+		return false;
+
+	in.LoadThrowing();
+	try {
+		MeshCacheKey key, keyFile(fileName, cleanPanels);
+		in % key;
+		if (!(key == keyFile))
+			return false;
+		SerializeCache(in, y0z, x0z);
+	} catch (LoadingError) {
+		mesh.Clear();
+		under.Clear();
+		hs = Hydrostatics();
+		return false;
+	}
+	in.Close();
+	FileSetTime(cacheFile, GetSysTime());	// Last use, for the eviction
+	bvh.Clear();
+	version++;
+	return true;
+}
+
+// Saves the mesh data got in AfterLoad(). Errors are ignored, as the cache only saves time.
+// It is written to a temporary file first, so other processes never read it partially
+void MeshData::StoreCache(String fileName, bool cleanPanels, bool y0z, bool x0z) {
+	BEM_PROFILE("MeshData::StoreCache");
+
+	if (cacheMaxSize == 0)
+		return;
+	String cacheFile = GetCacheFileName(fileName);
+	if (!RealizePath(cacheFile))
+		return;
+	String tempFile = cacheFile + "." + Uuid::Create().ToString() + ".tmp";
+	{
+		FileOut out(tempFile);
+		if (!out.IsOpen())
+			return;
+		MeshCacheKey key(fileName, cleanPanels);
+		out % key;
+		SerializeCache(out, y0z, x0z);
+		out.Close();
+		if (out.IsError()) {
+			FileDelete(tempFile);
+			return;
+		}
+	}
+	int64 added = GetFileLength(tempFile) - max<int64>(GetFileLength(cacheFile), 0);
+	FileDelete(cacheFile);
+	if (!FileMove(tempFile, cacheFile)) {
+		FileDelete(tempFile);
+		return;
+	}
+	TrimCache(added);
+}
+
+// Deletes the least recently used files until the cache is below 90% of cacheMaxSize.
+// The folder is only scanned when the size is unknown or the limit is passed
+void MeshData::TrimCache(int64 added) {
+	Mutex::Lock __(cacheMutex);
+	
+	if (cacheSize >= 0) {
+		cacheSize += added;
+		if (cacheSize <= cacheMaxSize)
+			return;
+	}
+	struct CacheFile : Moveable<CacheFile> {
+		String name;
+		int64 length;
+		Time time;
+	};
+	Upp::Vector<CacheFile> files;
+	cacheSize = 0;
+	for (FindFile ff(AppendFileName(GetCacheFolder(), "*.bmc")); ff; ff.Next()) {
+		if (!ff.IsFile())
+			continue;
+		CacheFile &file = files.Add();
+		file.name = ff.GetPath();
+		file.length = ff.GetLength();
+		file.time = Time(ff.GetLastWriteTime());
+		cacheSize += file.length;
+	}
+	if (cacheSize <= cacheMaxSize)
+		return;
+	
+	Sort(files, [](const CacheFile &a, const CacheFile &b) {return a.time < b.time;});
+	for (const CacheFile &file : files) {
+		if (cacheSize <= cacheMaxSize/10*9)
+			break;
+		if (FileDelete(file.name))
+			cacheSize -= file.length;
+	}
+}
+
+// Deletes all the cache files, including temporary files left by stopped processes
+void MeshData::ClearCache() {
+	Mutex::Lock __(cacheMutex);
+	
+	for (FindFile ff(AppendFileName(GetCacheFolder(), "*.bmc*")); ff; ff.Next())
+		if (ff.IsFile())
+			FileDelete(ff.GetPath());
+	cacheSize = 0;
+}
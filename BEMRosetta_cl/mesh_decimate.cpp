@@ -0,0 +1,124 @@
+#include "BEMRosetta.h"
+
+using namespace Eigen;
+
+struct Cluster : Moveable<Cluster> {
+	double A[6] = {};		// Quadric Σ area·n·nᵀ, upper triangle
+	double b[3] = {};		// Σ area·d·n, for planes n·p + d = 0
+	double sum[3] = {};		// Σ p
+	int num = 0;
+
+	void AddNode(const Point3D &p) {
+		sum[0] += p.x;
+		sum[1] += p.y;
+		sum[2] += p.z;
+		num++;
+	}
+	void AddPlane(const Vector3d &n, double d, double area) {
+		A[0] += area*n(0)*n(0);	A[1] += area*n(0)*n(1);	A[2] += area*n(0)*n(2);
+		A[3] += area*n(1)*n(1);	A[4] += area*n(1)*n(2);	A[5] += area*n(2)*n(2);
+		for (int k = 0; k < 3; ++k)
+			b[k] += area*d*n(k);
+	}
+	// Point minimizing the quadric error. Directions where the quadric is flat, as along edges
+	// or on planar regions, are left at the mean of the nodes
+	Point3D GetPoint() const {
+		Vector3d mean(sum[0]/num, sum[1]/num, sum[2]/num);
+		Matrix3d Q;
+		Q << A[0], A[1], A[2],
+			 A[1], A[3], A[4],
+			 A[2], A[4], A[5];
+		SelfAdjointEigenSolver<Matrix3d> es(Q);
+		const Vector3d &val = es.eigenvalues();
+		Vector3d grad = Q*mean + Vector3d(b[0], b[1], b[2]);
+		Vector3d x = mean;
+		double maxVal = val.cwiseAbs().maxCoeff();
+		for (int i = 0; i < 3; ++i)
+			if (maxVal > 0 && abs(val(i)) > 1E-3*maxVal)
+				x -= es.eigenvectors().col(i)*(es.eigenvectors().col(i).dot(grad)/val(i));
+		return Point3D(x(0), x(1), x(2));
+	}
+};
+
+// Simplifies a mesh for display to around numPanels, by vertex clustering in a grid:
+// nodes in the same cell are merged in the point that minimizes the quadric error of their panels,
+// and panels that collapse are removed
+void MeshData::Decimate(const Upp::Vector<Point3D> &nodes, const Upp::Vector<Panel> &panels, int numPanels, Surface &dest) {
+	BEM_PROFILE("MeshData::Decimate");
+
+	dest.nodes.Clear();
+	dest.panels.Clear();
+	if (panels.IsEmpty() || numPanels <= 0)
+		return;
+
+	auto GetPlane = [&](const Panel &pan, Vector3d &n, double &d) {
+		Vector3d p0(nodes[pan.id[0]].x, nodes[pan.id[0]].y, nodes[pan.id[0]].z),
+				 p1(nodes[pan.id[1]].x, nodes[pan.id[1]].y, nodes[pan.id[1]].z),
+				 p2(nodes[pan.id[2]].x, nodes[pan.id[2]].y, nodes[pan.id[2]].z),
+				 p3(nodes[pan.id[3]].x, nodes[pan.id[3]].y, nodes[pan.id[3]].z);
+		n = pan.IsTriangle() ? Vector3d((p1 - p0).cross(p2 - p0)) : Vector3d((p2 - p0).cross(p3 - p1));
+		double area = n.norm()/2;
+		if (area > 0)
+			n /= 2*area;
+		d = -n.dot((p0 + p1 + p2 + p3)/4);
+		return area;
+	};
+
+	double surface = 0;
+	for (const Panel &pan : panels) {
+		Vector3d n;
+		double d;
+		surface += GetPlane(pan, n, d);
+	}
+	double cell = sqrt(2*surface/numPanels);		// Smooth surfaces get around two panels per cell
+	if (cell <= 0)
+		return;
+
+	Index<Tuple<int, int, int>> cells;
+	Upp::Vector<Cluster> clusters;
+	Upp::Vector<int> idCluster(nodes.size(), -1);
+	for (const Panel &pan : panels) {
+		for (int i = 0; i < 4; ++i) {
+			int id = pan.id[i];
+			if (idCluster[id] >= 0)
+				continue;
+			const Point3D &p = nodes[id];
+			Tuple<int, int, int> key(int(floor(p.x/cell)), int(floor(p.y/cell)), int(floor(p.z/cell)));
+			int ic = cells.Find(key);
+			if (ic < 0) {
+				ic = cells.GetCount();
+				cells.Add(key);
+				clusters.Add();
+			}
+			idCluster[id] = ic;
+			clusters[ic].AddNode(p);
+		}
+	}
+
+	Upp::Vector<Panel> newPanels;
+	for (const Panel &pan : panels) {
+		int ids[4], num = 0;
+		for (int i = 0; i < 4; ++i) {
+			int ic = idCluster[pan.id[i]];
+			if (num == 0 || (ic != ids[num-1] && ic != ids[0]))
+				ids[num++] = ic;
+		}
+		if (num < 3)
+			continue;
+
+		Vector3d n;
+		double d;
+		double area = GetPlane(pan, n, d);
+		for (int i = 0; i < num; ++i)
+			clusters[ids[i]].AddPlane(n, d, area);
+
+		Panel &panel = newPanels.Add();
+		for (int i = 0; i < 4; ++i)
+			panel.id[i] = ids[i < num ? i : 0];			// Triangles repeat the first node
+	}
+
+	dest.nodes.SetCount(clusters.size());
+	for (int ic = 0; ic < clusters.size(); ++ic)
+		dest.nodes[ic] = clusters[ic].GetPoint();
+	dest.panels = pick(newPanels);
+}
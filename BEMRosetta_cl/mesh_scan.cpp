@@ -0,0 +1,113 @@
+#include "BEMRosetta.h"
+#include "BEMRosetta_int.h"
+
+
+bool MeshScan::Open(String fileName) {
+	if (!map.Open(fileName))
+		return false;
+	size_t size = size_t(map.GetFileSize());
+	if (size > 0) {
+		if (!map.Map(0, size))
+			return false;
+		begin = (const char *)map.Begin();
+	} else
+		begin = "";
+	p = begin;
+	end = begin + size;
+	line = 1;
+	return true;
+}
+
+// First len bytes of the file, to detect its format
+String MeshScan::Peek(String fileName, int len) {
+	FileIn in(fileName);
+	if (!in.IsOpen())
+		return String();
+	return in.Get(int(min<int64>(len, in.GetSize())));
+}
+
+void MeshScan::SkipBlanks() {
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+		p++;
+}
+
+bool MeshScan::IsEol() {
+	SkipBlanks();
+	return p >= end || *p == '\n';
+}
+
+String MeshScan::GetLine() {
+	const char *from = p;
+	while (p < end && *p != '\n')
+		p++;
+	const char *to = p;
+	if (to > from && to[-1] == '\r')
+		to--;
+	if (p < end) {
+		p++;
+		line++;
+	}
+	return String(from, to);
+}
+
+void MeshScan::NextLine() {
+	while (p < end && *p != '\n')
+		p++;
+	if (p < end) {
+		p++;
+		line++;
+	}
+}
+
+// Goes after the next line that contains text
+bool MeshScan::FindLine(const char *text) {
+	while (!IsEof()) {
+		bool found = LineContains(text);
+		NextLine();
+		if (found)
+			return true;
+	}
+	return false;
+}
+
+bool MeshScan::LineContains(const char *text) const {
+	int len = (int)strlen(text);
+	for (const char *s = p; s + len <= end && *s != '\n'; ++s)
+		if (memcmp(s, text, len) == 0)
+			return true;
+	return false;
+}
+
+// Copies the next field in the line to buf, as the file is not null terminated
+const char *MeshScan::GetField(char *buf, int len) {
+	SkipBlanks();
+	const char *from = p;
+	while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+		p++;
+	int num = int(p - from);
+	if (num == 0)
+		throw Exc(Str() + "\n" + t_("Missing field"));
+	if (num >= len)
+		throw Exc(Str() + "\n" + Format(t_("Wrong field '%s'"), String(from, min(num, 40))));
+	memcpy(buf, from, num);
+	buf[num] = '\0';
+	return buf;
+}
+
+double MeshScan::GetDouble() {
+	char buf[64];
+	const char *field = GetField(buf, sizeof(buf)), *endptr;
+	double ret = ScanDouble(field, &endptr);
+	if (IsNull(ret) || *endptr != '\0')
+		throw Exc(Str() + "\n" + Format(t_("Wrong number '%s'"), field));
+	return ret;
+}
+
+int MeshScan::GetInt() {
+	char buf[64];
+	const char *field = GetField(buf, sizeof(buf)), *endptr;
+	int ret = ScanInt(field, &endptr);
+	if (IsNull(ret) || *endptr != '\0')
+		throw Exc(Str() + "\n" + Format(t_("Wrong number '%s'"), field));
+	return ret;
+}
@@ -0,0 +1,138 @@
+#include "BEMRosetta.h"
+
+using namespace Eigen;
+
+void MeshSoA::Load(const Upp::Vector<Point3D> &nodes, const Upp::Vector<Panel> &panels) {
+	int numNodes = nodes.size(), numPanels = panels.size();
+	x.resize(numNodes);
+	y.resize(numNodes);
+	z.resize(numNodes);
+	for (int i = 0; i < numNodes; ++i) {
+		x(i) = nodes[i].x;
+		y(i) = nodes[i].y;
+		z(i) = nodes[i].z;
+	}
+	for (int j = 0; j < 4; ++j)
+		id[j].resize(numPanels);
+	for (int ip = 0; ip < numPanels; ++ip)
+		for (int j = 0; j < 4; ++j)
+			id[j](ip) = panels[ip].id[j];
+
+	nx.resize(0);
+	ny.resize(0);
+	nz.resize(0);
+	area.resize(0);
+	cx.resize(0);
+	cy.resize(0);
+	cz.resize(0);
+}
+
+// Sets nodes and panel node ids in surf. Other panel data has to be got again
+void MeshSoA::Save(Surface &surf) const {
+	surf.nodes.SetCount(GetNodeCount());
+	for (int i = 0; i < GetNodeCount(); ++i)
+		surf.nodes[i] = GetNode(i);
+	surf.panels.SetCount(GetPanelCount());
+	for (int ip = 0; ip < GetPanelCount(); ++ip)
+		for (int j = 0; j < 4; ++j)
+			surf.panels[ip].id[j] = id[j](ip);
+}
+
+// Gathers the coordinates of node j of panels [from, to)
+void MeshSoA::GetPanelNodes(int from, int to, int j, ArrayXd &px, ArrayXd &py, ArrayXd &pz) const {
+	int num = to - from;
+	px.resize(num);
+	py.resize(num);
+	pz.resize(num);
+	const int *ids = id[j].data() + from;
+	for (int i = 0; i < num; ++i) {
+		px(i) = x(ids[i]);
+		py(i) = y(ids[i]);
+		pz(i) = z(ids[i]);
+	}
+}
+
+// Unit normal, area and centroid of all panels.
+// Normal is the cross product of the diagonals, that for triangles is the one of two sides
+void MeshSoA::GetPanelParams() {
+	BEM_PROFILE("MeshSoA::GetPanelParams");
+
+	int num = GetPanelCount();
+	ArrayXd x0, y0, z0, x1, y1, z1, x2, y2, z2, x3, y3, z3;
+	GetPanelNodes(0, num, 0, x0, y0, z0);
+	GetPanelNodes(0, num, 1, x1, y1, z1);
+	GetPanelNodes(0, num, 2, x2, y2, z2);
+	GetPanelNodes(0, num, 3, x3, y3, z3);
+
+	ArrayXd ax = x2 - x0, ay = y2 - y0, az = z2 - z0;
+	ArrayXd bx = x3 - x1, by = y3 - y1, bz = z3 - z1;
+	nx = ay*bz - az*by;
+	ny = az*bx - ax*bz;
+	nz = ax*by - ay*bx;
+	ArrayXd len = (nx.square() + ny.square() + nz.square()).sqrt();
+	area = len/2;
+	ArrayXd inv = (len > 0).select(len.inverse(), 0);
+	nx *= inv;
+	ny *= inv;
+	nz *= inv;
+
+	Eigen::Array<bool, Dynamic, 1> tri = id[3] == id[0];
+	cx = tri.select((x0 + x1 + x2)/3, (x0 + x1 + x2 + x3)/4);
+	cy = tri.select((y0 + y1 + y2)/3, (y0 + y1 + y2 + y3)/4);
+	cz = tri.select((z0 + z1 + z2)/3, (z0 + z1 + z2 + z3)/4);
+}
+
+void MeshSoA::Translate(double dx, double dy, double dz) {
+	x += dx;
+	y += dy;
+	z += dz;
+	if (cx.size() > 0) {
+		cx += dx;
+		cy += dy;
+		cz += dz;
+	}
+}
+
+// p' = R·p + t. Normals are rotated too
+void MeshSoA::Transform(const Matrix3d &R, const Vector3d &t) {
+	auto Apply = [&](ArrayXd &ax, ArrayXd &ay, ArrayXd &az, bool translate) {
+		ArrayXd rx = R(0, 0)*ax + R(0, 1)*ay + R(0, 2)*az;
+		ArrayXd ry = R(1, 0)*ax + R(1, 1)*ay + R(1, 2)*az;
+		az = R(2, 0)*ax + R(2, 1)*ay + R(2, 2)*az;
+		ax = pick(rx);
+		ay = pick(ry);
+		if (translate) {
+			ax += t(0);
+			ay += t(1);
+			az += t(2);
+		}
+	};
+	Apply(x, y, z, true);
+	if (nx.size() > 0) {
+		Apply(nx, ny, nz, false);
+		Apply(cx, cy, cz, true);
+	}
+}
+
+// Reflects the mesh in the plane normal to axis (0 x, 1 y, 2 z).
+// Panels are reversed so normals are still outwards
+void MeshSoA::Mirror(int axis) {
+	ASSERT(axis >= 0 && axis < 3);
+
+	ArrayXd &c = axis == 0 ? x : axis == 1 ? y : z;
+	c = -c;
+	if (nx.size() > 0) {
+		ArrayXd &n = axis == 0 ? nx : axis == 1 ? ny : nz;
+		ArrayXd &cc = axis == 0 ? cx : axis == 1 ? cy : cz;
+		n = -n;
+		cc = -cc;
+	}
+	// Quads 0, 1, 2, 3 -> 0, 3, 2, 1. Triangles 0, 1, 2, 0 -> 0, 2, 1, 0
+	Eigen::Array<bool, Dynamic, 1> tri = id[3] == id[0];
+	ArrayXi id1 = tri.select(id[2], id[3]);
+	ArrayXi id2 = tri.select(id[1], id[2]);
+	ArrayXi id3 = tri.select(id[0], id[1]);
+	id[1] = pick(id1);
+	id[2] = pick(id2);
+	id[3] = pick(id3);
+}
@@ -0,0 +1,59 @@
+#include "BEMRosetta.h"
+
+// Groups the panels connected by shared nodes, with a union-find over the node ids.
+// Sets are sorted by their first panel
+Upp::Vector<Upp::Vector<int>> MeshData::GetPanelSets(const Surface &surf) {
+	BEM_PROFILE("MeshData::GetPanelSets");
+
+	int numNodes = surf.nodes.size();
+	Upp::Vector<int> parent(numNodes), size(numNodes, 1);
+	for (int i = 0; i < numNodes; ++i)
+		parent[i] = i;
+
+	auto Find = [&](int i) {
+		while (parent[i] != i) {
+			parent[i] = parent[parent[i]];		// Path halving
+			i = parent[i];
+		}
+		return i;
+	};
+	for (const Panel &pan : surf.panels) {
+		int r0 = Find(pan.id[0]);
+		for (int i = 1; i < 4; ++i) {
+			int r = Find(pan.id[i]);
+			if (r == r0)
+				continue;
+			if (size[r] > size[r0])
+				Swap(r, r0);
+			parent[r] = r0;
+			size[r0] += size[r];
+		}
+	}
+
+	Upp::Vector<Upp::Vector<int>> sets;
+	Upp::Vector<int> idSet(numNodes, -1);
+	for (int ip = 0; ip < surf.panels.size(); ++ip) {
+		int r = Find(surf.panels[ip].id[0]);
+		if (idSet[r] < 0) {
+			idSet[r] = sets.size();
+			sets.Add();
+		}
+		sets[idSet[r]] << ip;
+	}
+	return sets;
+}
+
+// Copies to dest the panels in ids, with only the nodes they use
+void MeshData::ExtractPanels(const Surface &orig, const Upp::Vector<int> &ids, Surface &dest) {
+	Index<int> idNodes;
+	dest.panels.Reserve(ids.size());
+	for (int ip : ids) {
+		dest.panels << clone(orig.panels[ip]);
+		Panel &pan = dest.panels.Top();
+		for (int i = 0; i < 4; ++i)
+			pan.id[i] = idNodes.FindAdd(pan.id[i]);
+	}
+	dest.nodes.SetCount(idNodes.size());
+	for (int i = 0; i < idNodes.size(); ++i)
+		dest.nodes[i] = orig.nodes[idNodes[i]];
+}
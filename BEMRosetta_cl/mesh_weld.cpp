@@ -0,0 +1,66 @@
+#include "BEMRosetta.h"
+
+NodeWelder::NodeWelder(Upp::Vector<Point3D> &_nodes, double tolerance) : nodes(_nodes), tol(tolerance) {
+	keys.Reserve(nodes.size());
+	for (const Point3D &p : nodes)
+		keys.Add(Key(p));
+}
+
+hash_t NodeWelder::Key(int64 ix, int64 iy, int64 iz) {
+	return CombineHash() << ix << iy << iz;
+}
+
+hash_t NodeWelder::Key(const Point3D &p) const {
+	if (tol <= 0)
+		return CombineHash() << p.x + 0. << p.y + 0. << p.z + 0.;		// + 0. so -0 and 0 are the same
+	return Key(int64(floor(p.x/tol)), int64(floor(p.y/tol)), int64(floor(p.z/tol)));
+}
+
+// Returns the id of a node closer than the tolerance to p, or of p once added.
+// Only the nodes in the same cell, or in the 26 neighbours if tolerance is not zero, are checked
+int NodeWelder::Add(const Point3D &p) {
+	if (tol <= 0) {
+		hash_t key = Key(p);
+		for (int id = keys.Find(key); id >= 0; id = keys.FindNext(id)) {
+			const Point3D &node = nodes[id];
+			if (node.x == p.x && node.y == p.y && node.z == p.z)
+				return id;
+		}
+		nodes << p;
+		keys.Add(key);
+		return nodes.size() - 1;
+	}
+	
+	int64 ix = int64(floor(p.x/tol)), iy = int64(floor(p.y/tol)), iz = int64(floor(p.z/tol));
+	double tol2 = tol*tol;
+	for (int64 dx = -1; dx <= 1; ++dx)
+		for (int64 dy = -1; dy <= 1; ++dy)
+			for (int64 dz = -1; dz <= 1; ++dz) 
+				for (int id = keys.Find(Key(ix+dx, iy+dy, iz+dz)); id >= 0; id = keys.FindNext(id)) {
+					const Point3D &node = nodes[id];
+					if (sqr(node.x - p.x) + sqr(node.y - p.y) + sqr(node.z - p.z) <= tol2)
+						return id;
+				}
+	nodes << p;
+	keys.Add(Key(ix, iy, iz));
+	return nodes.size() - 1;
+}
+
+// Merges the nodes closer than tolerance, renumbering the panels. Nodes not used by any panel are removed
+void NodeWelder::Weld(Upp::Vector<Panel> &panels, Upp::Vector<Point3D> &_nodes, double tolerance) {
+	BEM_PROFILE("NodeWelder::Weld");
+	
+	Upp::Vector<Point3D> newNodes;
+	newNodes.Reserve(_nodes.size());
+	NodeWelder welder(newNodes, tolerance);
+	
+	Upp::Vector<int> newIds(_nodes.size(), -1);
+	for (Panel &panel : panels) 
+		for (int i = 0; i < 4; ++i) {
+			int &id = panel.id[i];
+			if (newIds[id] < 0)
+				newIds[id] = welder.Add(_nodes[id]);
+			id = newIds[id];
+		}
+	_nodes = pick(newNodes);
+}
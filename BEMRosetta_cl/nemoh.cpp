@@ -3,6 +3,7 @@
 #include <STEM4U/Utility.h>
 
 bool Nemoh::Load(String file, double) {
+	BEM_PROFILE("Nemoh::Load");
 	try {
 		String ext = GetFileExt(file); 
 
@@ -97,6 +98,7 @@ bool Nemoh::Load(String file, double) {
 }
 
 bool Nemoh::Load_Cal(String fileName) {	
+	BEM_PROFILE("Nemoh::Load_Cal");
 	if (!datacal.Load(fileName))
 		return false;
 
@@ -696,6 +698,7 @@ void NemohCal::Save_Cal(String folder, int _nf, double _minf, double _maxf) cons
 }
 
 bool Nemoh::Load_Inf(String fileName) {
+	BEM_PROFILE("Nemoh::Load_Inf");
 	if (hd().Nb != 1)
 		throw Exc(Format(t_("SeaFEM_Nemoh only allows one body, found %d"), hd().Nb));
 
@@ -756,6 +759,7 @@ bool Nemoh::Load_Inf(String fileName) {
 }
 	
 bool Nemoh::Load_Hydrostatics() {
+	BEM_PROFILE("Nemoh::Load_Hydrostatics");
 	hd().cg.setConstant(3, hd().Nb, Null);
 	hd().cb.setConstant(3, hd().Nb, Null);
 	hd().Vo.SetCount(hd().Nb, Null);
@@ -786,6 +790,7 @@ bool Nemoh::Load_Hydrostatics() {
 }
 
 bool Nemoh::Load_KH() {
+	BEM_PROFILE("Nemoh::Load_KH");
 	hd().C.SetCount(hd().Nb);
 	for (int ib = 0; ib < hd().Nb; ++ib) {
 	    String fileKH;
@@ -812,6 +817,7 @@ bool Nemoh::Load_KH() {
 }
 
 bool Nemoh::Load_Radiation(String fileName) {
+	BEM_PROFILE("Nemoh::Load_Radiation");
 	FileInLine in(fileName);
 	if (!in.IsOpen())
 		return false;
@@ -868,6 +874,7 @@ bool Nemoh::Load_FroudeKrylov(String folder) {
 }
 
 bool Nemoh::Load_Forces(Hydro::Forces &fc, String nfolder, String fileName) {
+	BEM_PROFILE("Nemoh::Load_Forces");
 	FileInLine in(AppendFileName(nfolder, AppendFileName("Results", fileName)));
 	if (!in.IsOpen())
 		return false;
@@ -913,6 +920,7 @@ bool Nemoh::Load_Forces(Hydro::Forces &fc, String nfolder, String fileName) {
 }
 
 bool Nemoh::Load_IRF(String fileName) {
+	BEM_PROFILE("Nemoh::Load_IRF");
 	FileInLine in(fileName);
 	if (!in.IsOpen())
 		return false;
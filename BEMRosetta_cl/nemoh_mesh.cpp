@@ -3,55 +3,53 @@
 
 
 String MeshData::LoadDatNemoh(String fileName, bool &x0z) {
-	FileInLine in(fileName);
-	if (!in.IsOpen()) 
+	MeshScan in;
+	if (!in.Open(fileName)) 
 		return Format(t_("Impossible to open file '%s'"), fileName);
 	
 	this->fileName = fileName;
 	SetCode(MeshData::NEMOH_DAT);
 	
 	try {
-		String line;
-		FieldSplit f(in);	
-		f.IsSeparator = IsTabSpace;
-			
-		line = in.GetLine();	
-		f.Load(line);
-	
-		if (!f.IsInt(0) || f.GetInt(0) != 2)
+		if (in.GetInt() != 2)
 			return t_("Format error in Nemoh .dat mesh file");	// To detect Nemoh format
 		
-		if (f.GetInt(1) == 1)
+		if (in.GetInt() == 1)
 			x0z = true;
+		in.NextLine();
 		
 		mesh.Clear();
 		
-		while(true) {
-			line = in.GetLine();
-			if (in.IsEof())
-				break;	
-			f.Load(line);
-			int id = f.GetInt(0);	
-			if (id == 0)
+		while(!in.IsEof()) {
+			if (in.IsEol()) {
+				in.NextLine();
+				continue;
+			}
+			int id = in.GetInt();	
+			if (id == 0) {
+				in.NextLine();
 				break;
+			}
 			Point3D &node = mesh.nodes.Add();
-			node.x = f.GetDouble(1);
-			node.y = f.GetDouble(2);
-			node.z = f.GetDouble(3); 
+			node.x = in.GetDouble();
+			node.y = in.GetDouble();
+			node.z = in.GetDouble(); 
+			in.NextLine();
 		}
-		while(true) {
-			line = in.GetLine();	
-			if (in.IsEof())
-				break;
-			f.Load(line);
-			int id0 = f.GetInt(0);	
+		while(!in.IsEof()) {
+			if (in.IsEol()) {
+				in.NextLine();
+				continue;
+			}
+			int id0 = in.GetInt();	
 			if (id0 == 0)
 				break;
 			Panel &panel = mesh.panels.Add();
 			panel.id[0] = id0-1;
-			panel.id[1] = f.GetInt(1)-1;	
-			panel.id[2] = f.GetInt(2)-1;	
-			panel.id[3] = f.GetInt(3)-1;	
+			panel.id[1] = in.GetInt()-1;	
+			panel.id[2] = in.GetInt()-1;	
+			panel.id[3] = in.GetInt()-1;
+			in.NextLine();
 		}	
 	} catch (Exc e) {
 		return t_("Parsing error: ") + e;
@@ -0,0 +1,87 @@
+#include "BEMRosetta.h"
+
+std::atomic<bool> Profiler::enabled(false);
+
+struct ProfileEvent : Moveable<ProfileEvent> {
+	const char *name;
+	int64 start, duration;
+	int tid;
+};
+
+static StaticMutex mutex;
+static Upp::Vector<ProfileEvent> events;
+static VectorMap<String, int64> counters;
+static Index<Thread::Id> threadIds;
+
+void Profiler::Clear() {
+	Mutex::Lock __(mutex);
+	events.Clear();
+	counters.Clear();
+	threadIds.Clear();
+}
+
+void Profiler::AddTime(const char *name, int64 start, int64 duration) {
+	Mutex::Lock __(mutex);
+	ProfileEvent &ev = events.Add();
+	ev.name = name;
+	ev.start = start;
+	ev.duration = duration;
+	ev.tid = threadIds.FindAdd(Thread::GetCurrentId());
+}
+
+void Profiler::AddCount(const char *name, int64 num) {
+	Mutex::Lock __(mutex);
+	counters.GetAdd(name, 0) += num;
+}
+
+// Table with calls, total, mean and max time of each stage, sorted by total time, and the counters
+String Profiler::GetSummary() {
+	Mutex::Lock __(mutex);
+	
+	struct Stage {
+		int calls = 0;
+		int64 total = 0, max = 0;
+	};
+	VectorMap<String, Stage> stages;
+	int64 first = INT64_MAX, last = 0;
+	for (const ProfileEvent &ev : events) {
+		Stage &st = stages.GetAdd(ev.name);
+		st.calls++;
+		st.total += ev.duration;
+		st.max = Upp::max(st.max, ev.duration);
+		first = min(first, ev.start);
+		last = Upp::max(last, ev.start + ev.duration);
+	}
+	StableSortByValue(stages, [](const Stage &a, const Stage &b) {return a.total > b.total;});
+	
+	String ret;
+	ret << "\n" << Format("%-36s %8s %12s %12s %12s", t_("Stage"), t_("Calls"), t_("Total [ms]"), t_("Mean [ms]"), t_("Max [ms]"));
+	for (int i = 0; i < stages.size(); ++i) {
+		const Stage &st = stages[i];
+		ret << "\n" << Format("%-36s %8d %12.3f %12.3f %12.3f", stages.GetKey(i), st.calls, 
+					st.total/1000., st.total/1000./st.calls, st.max/1000.);
+	}
+	if (!events.IsEmpty())
+		ret << "\n" << Format(t_("Elapsed time from first to last stage: %.3f ms"), (last - first)/1000.);
+	for (int i = 0; i < counters.size(); ++i)
+		ret << "\n" << Format("%-36s %8d", counters.GetKey(i), counters[i]);
+	return ret;
+}
+
+// Trace Event Format file, to be opened with chrome://tracing or Perfetto
+void Profiler::SaveChromeTrace(String fileName) {
+	Mutex::Lock __(mutex);
+	
+	FileOut out(fileName);
+	if (!out.IsOpen())
+		throw Exc(Format(t_("Impossible to open file '%s'"), fileName));
+	
+	out << "{\"traceEvents\":[";
+	for (int i = 0; i < events.size(); ++i) {
+		const ProfileEvent &ev = events[i];
+		out << (i > 0 ? ",\n" : "\n") 
+			<< Format("{\"name\":%s,\"ph\":\"X\",\"ts\":%d,\"dur\":%d,\"pid\":1,\"tid\":%d}", 
+					  AsJSON(String(ev.name)), ev.start, ev.duration, ev.tid);
+	}
+	out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
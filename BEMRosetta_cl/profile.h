@@ -0,0 +1,43 @@
+#ifndef _BEMRosetta_BEMRosetta_cl_profile_h_
+#define _BEMRosetta_BEMRosetta_cl_profile_h_
+
+// Timers and counters of the load, processing and save stages.
+// When disabled, a BEM_PROFILE scope only checks a flag
+class Profiler {
+public:
+	static void Enable(bool enable = true)	{enabled = enable;}
+	static bool IsEnabled()					{return enabled.load(std::memory_order_relaxed);}
+	
+	static void Clear();
+	static void AddTime(const char *name, int64 start, int64 duration);
+	static void AddCount(const char *name, int64 num);
+	
+	static String GetSummary();
+	static void SaveChromeTrace(String fileName);
+
+private:
+	static std::atomic<bool> enabled;
+};
+
+class ProfileScope {
+public:
+	ProfileScope(const char *_name) {
+		if (Profiler::IsEnabled()) {
+			name = _name;
+			start = usecs();
+		}
+	}
+	~ProfileScope() {
+		if (name)
+			Profiler::AddTime(name, start, usecs() - start);
+	}
+
+private:
+	const char *name = nullptr;
+	int64 start = 0;
+};
+
+#define BEM_PROFILE(name)				ProfileScope COMBINE(bemProfile, __LINE__)(name)
+#define BEM_PROFILE_COUNT(name, num)	do {if (Profiler::IsEnabled()) Profiler::AddCount(name, num);} while (false)
+
+#endif
@@ -0,0 +1,150 @@
+#include "BEMRosetta.h"
+
+using namespace Eigen;
+
+// Mass matrix (6*Nb, 6*Nb) from _M, or from Hydro::M if _M is empty
+bool Hydro::GetMassMatrix(const MatrixXd &_M, MatrixXd &mass) {
+	int ndof = 6*Nb;
+	if (_M.size() > 0)
+		mass = _M;
+	else if (IsLoadedM()) {
+		mass = MatrixXd::Zero(ndof, ndof);
+		for (int ib = 0; ib < Nb; ++ib)
+			mass.block(6*ib, 6*ib, 6, 6) = M[ib];
+	} else {
+		lastError = t_("Mass matrix is required");
+		return false;
+	}
+	return true;
+}
+
+bool Hydro::CheckDynMatrices(const MatrixXd &mass, const MatrixXd &Dlin, const MatrixXd &Dquad, const MatrixXd &Cmoor) {
+	int ndof = 6*Nb;
+	auto CheckSize = [&](const MatrixXd &m, const char *name)->bool {
+		if (m.size() > 0 && (m.rows() != ndof || m.cols() != ndof)) {
+			lastError = Format(t_("Wrong %s matrix size. It has to be %dx%d"), name, ndof, ndof);
+			return false;
+		}
+		return true;
+	};
+	return CheckSize(mass, "M") && CheckSize(Dlin, "Dlin") && CheckSize(Dquad, "Dquad") && CheckSize(Cmoor, "Cmoor");
+}
+
+// Gets the RAO for all frequencies and headings solving [-ω²(M+A) + iω(B+Dlin+Dquad_eq) + C + Cmoor]·RAO = Fex.
+// All matrices are dimensional and (6*Nb, 6*Nb). If M is empty Hydro::M is used. Dlin, Dquad and Cmoor may be empty.
+// Quadratic damping is linearised for unit wave amplitude as 8/(3π)·ω·|RAO|·Dquad
+bool Hydro::GetRAO(const MatrixXd &_M, const MatrixXd &Dlin, const MatrixXd &Dquad, const MatrixXd &Cmoor,
+				Function <bool(String, int)> Status) {
+	if (!IsLoadedA() || !IsLoadedB() || !IsLoadedFex()) {
+		lastError = t_("A, B and excitation forces are required to get the RAO");
+		return false;
+	}
+	int ndof = 6*Nb;
+	MatrixXd mass;
+	if (!GetMassMatrix(_M, mass) || !CheckDynMatrices(mass, Dlin, Dquad, Cmoor))
+		return false;
+
+	Upp::Vector<int> dofs;				// Only DOF with coefficients are solved
+	for (int idf = 0; idf < ndof; ++idf)
+		if (!IsNull(A[idf][idf][0]) && !IsNull(B[idf][idf][0]) && !IsNull(ex.re[0](0, idf)))
+			dofs << idf;
+	int n = dofs.size();
+	if (n == 0) {
+		lastError = t_("No DOF available to get the RAO");
+		return false;
+	}
+
+	MatrixXd K = MatrixXd::Zero(n, n), Ml(n, n), Dl = MatrixXd::Zero(n, n), Dq = MatrixXd::Zero(n, n);
+	for (int i = 0; i < n; ++i) {
+		int idf = dofs[i], ib = idf/6;
+		for (int j = 0; j < n; ++j) {
+			int jdf = dofs[j], jb = jdf/6;
+			Ml(i, j) = mass(idf, jdf);
+			if (IsLoadedC() && ib == jb)
+				K(i, j) = C_dim(ib, idf - 6*ib, jdf - 6*jb);
+			if (Cmoor.size() > 0)
+				K(i, j) += Cmoor(idf, jdf);
+			if (Dlin.size() > 0)
+				Dl(i, j) = Dlin(idf, jdf);
+			if (Dquad.size() > 0)
+				Dq(i, j) = Dquad(idf, jdf);
+		}
+	}
+	bool isQuad = Dquad.size() > 0 && !Dq.isZero();
+
+	if (!Status(t_("Getting RAO"), 10)) {
+		lastError = t_("Cancelled by user");
+		return false;
+	}
+
+	Initialize_RAO();
+
+	// From physical RAO to the stored convention, the inverse of R_*_dim()
+	auto ToStored = [&](double val, int idf)->double {
+		return dimen ? val*g_rho_ndim()/g_rho_dim() : val/(g_rho_dim()*pow(len, GetK_RAO(idf)));
+	};
+
+	try {
+		CoWork co;
+		for (int ifr = 0; ifr < Nf; ++ifr) {
+			co & [&, ifr] {
+				double ww = w[ifr];
+				if (ww <= 0)
+					return;
+
+				MatrixXcd Z(n, n);
+				for (int i = 0; i < n; ++i)
+					for (int j = 0; j < n; ++j) {
+						int idf = dofs[i], jdf = dofs[j];
+						double a = IsNull(A[idf][jdf][ifr]) ? 0 : A_dim(ifr, idf, jdf);
+						double b = IsNull(B[idf][jdf][ifr]) ? 0 : B_dim(ifr, idf, jdf);
+						Z(i, j) = std::complex<double>(-ww*ww*(Ml(i, j) + a) + K(i, j), ww*(b + Dl(i, j)));
+					}
+
+				MatrixXcd F(n, Nh);
+				for (int ih = 0; ih < Nh; ++ih)
+					for (int i = 0; i < n; ++i) {
+						int idf = dofs[i];
+						F(i, ih) = std::complex<double>(F_re_dim(ex, ih, ifr, idf), F_im_dim(ex, ih, ifr, idf));
+					}
+
+				MatrixXcd X = Z.partialPivLu().solve(F);		// All headings at once
+
+				if (isQuad) {			// Damping depends on motion amplitude, so each heading is iterated
+					for (int ih = 0; ih < Nh; ++ih) {
+						VectorXcd x = X.col(ih);
+						for (int iter = 0; iter < 50; ++iter) {
+							MatrixXcd Zq = Z;
+							for (int i = 0; i < n; ++i)
+								for (int j = 0; j < n; ++j)
+									Zq(i, j) += std::complex<double>(0, ww*8/(3*M_PI)*ww*abs(x(j))*Dq(i, j));
+							VectorXcd xn = Zq.partialPivLu().solve(F.col(ih));
+							double delta = (xn - x).norm();
+							x = 0.5*(x + xn);	// Relaxed for a smoother convergence
+							if (delta <= 1E-6*(1 + xn.norm()))
+								break;
+						}
+						X.col(ih) = x;
+					}
+				}
+
+				for (int ih = 0; ih < Nh; ++ih)
+					for (int i = 0; i < n; ++i) {
+						int idf = dofs[i];
+						std::complex<double> x = X(i, ih);
+						rao.re[ih](ifr, idf) = ToStored(x.real(), idf);
+						rao.im[ih](ifr, idf) = ToStored(x.imag(), idf);
+						rao.ma[ih](ifr, idf) = ToStored(abs(x), idf);
+						rao.ph[ih](ifr, idf) = arg(x);
+					}
+			};
+		}
+		co.Finish();
+	} catch (Exc e) {
+		lastError = e;
+		return false;
+	}
+
+	Status(t_("RAO obtained"), 100);
+	return true;
+}
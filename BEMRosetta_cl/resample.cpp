@@ -0,0 +1,223 @@
+#include "BEMRosetta.h"
+#include "functions.h"
+
+using namespace Eigen;
+
+static void ResampleForces(Hydro::Forces &f, const Interpolator &tab, const Interpolator &lin) {
+	for (int ih = 0; ih < f.ma.size(); ++ih) {
+		MatrixXd ma, ph;
+		tab.Apply(f.ma[ih], ma);
+		lin.ApplyPhase(f.ph[ih], ph);			// Phase aware, so it doesn't jump at ±π
+		f.re[ih].resize(ma.rows(), ma.cols());
+		f.im[ih].resize(ma.rows(), ma.cols());
+		for (Eigen::Index r = 0; r < ma.rows(); ++r)
+			for (Eigen::Index c = 0; c < ma.cols(); ++c) {
+				if (IsNull(ma(r, c)) || IsNull(ph(r, c))) {
+					ma(r, c) = ph(r, c) = f.re[ih](r, c) = f.im[ih](r, c) = Null;
+					continue;
+				}
+				f.re[ih](r, c) = ma(r, c)*cos(ph(r, c));
+				f.im[ih](r, c) = ma(r, c)*sin(ph(r, c));
+			}
+		f.ma[ih] = pick(ma);
+		f.ph[ih] = pick(ph);
+	}
+}
+
+static void ResampleAB(Upp::Array<Upp::Array<VectorXd>> &data, int Nf, const Interpolator &tab) {
+	for (int i = 0; i < data.size(); ++i)
+		for (int j = 0; j < data[i].size(); ++j) {
+			VectorXd &d = data[i][j];
+			if (d.size() != Nf)
+				continue;
+			VectorXd n(tab.GetCount());
+			tab.Apply(d, n);
+			d = pick(n);
+		}
+}
+
+// Resamples all the frequency dependent data onto frequencies nw.
+// Interpolation tables are got once and shared by all the coefficients
+void Hydro::ResampleW(const Upp::Vector<double> &nw, bool cubic) {
+	if (Nf < 2 || nw.IsEmpty())
+		return;
+
+	VectorXd wold = Get_w();
+	VectorXd wnew = Map<const VectorXd>(nw, nw.size());
+
+	Interpolator lin, cub;
+	lin.Init(wold, wnew, Interpolator::LINEAR);
+	if (cubic)
+		cub.Init(wold, wnew, Interpolator::CUBIC);
+	const Interpolator &tab = cubic ? cub : lin;
+
+	ResampleAB(A, Nf, tab);
+	ResampleAB(B, Nf, tab);
+	ResampleAB(Ainfw, Nf, tab);
+
+	ResampleForces(ex, tab, lin);
+	ResampleForces(sc, tab, lin);
+	ResampleForces(fk, tab, lin);
+	ResampleForces(rao, tab, lin);
+
+	for (int i = 0; i < sts.size(); ++i)
+		for (int j = 0; j < sts[i].size(); ++j) {
+			StateSpace &st = sts[i][j];
+			if (st.A_ss.size() == 0 && st.TFS.size() == Nf) {
+				VectorXd ma(Nf), ph(Nf), nma(nw.size()), nph(nw.size());
+				for (int ifr = 0; ifr < Nf; ++ifr) {
+					ma(ifr) = abs(st.TFS[ifr]);
+					ph(ifr) = arg(st.TFS[ifr]);
+				}
+				tab.Apply(ma, nma);
+				lin.ApplyPhase(ph, nph);
+				st.TFS.SetCount(nw.size());
+				for (int ifr = 0; ifr < nw.size(); ++ifr)
+					st.TFS[ifr] = IsNull(nma(ifr)) ? std::complex<double>(Null, Null) : std::polar(nma(ifr), nph(ifr));
+			}
+		}
+	GetTFS(nw);
+
+	w = clone(nw);
+	Nf = w.size();
+	T.SetCount(Nf);
+	for (int ifr = 0; ifr < Nf; ++ifr)
+		T[ifr] = w[ifr] > 0 ? 2*M_PI/w[ifr] : double(Null);
+}
+
+// Interpolates the forces between the closest headings, as in GetResponseStats(). Magnitude is linear
+// and phase follows the shortest arc. Headings out of the model ones are Null
+static void ResampleForcesHead(Hydro::Forces &f, const Upp::Vector<double> &head, const Upp::Vector<double> &nhead) {
+	if (f.ma.IsEmpty())
+		return;
+	Eigen::Index rows = f.ma[0].rows(), cols = f.ma[0].cols();
+	Upp::Array<MatrixXd> ma(nhead.size()), ph(nhead.size()), re(nhead.size()), im(nhead.size());
+	for (int inh = 0; inh < nhead.size(); ++inh) {
+		ma[inh].setConstant(rows, cols, Null);
+		ph[inh].setConstant(rows, cols, Null);
+		re[inh].setConstant(rows, cols, Null);
+		im[inh].setConstant(rows, cols, Null);
+		int ih0, ih1;
+		double fh;
+		if (!GetHeadingBracket(head, nhead[inh], ih0, ih1, fh))
+			continue;
+		for (Eigen::Index r = 0; r < rows; ++r)
+			for (Eigen::Index c = 0; c < cols; ++c) {
+				double ma0 = f.ma[ih0](r, c), ma1 = f.ma[ih1](r, c), ph0 = f.ph[ih0](r, c), ph1 = f.ph[ih1](r, c);
+				if (IsNull(ma0) || IsNull(ma1) || IsNull(ph0) || IsNull(ph1))
+					continue;
+				double m = ma0 + fh*(ma1 - ma0);
+				double p = remainder(ph0 + fh*remainder(ph1 - ph0, 2*M_PI), 2*M_PI);
+				ma[inh](r, c) = m;
+				ph[inh](r, c) = p;
+				re[inh](r, c) = m*cos(p);
+				im[inh](r, c) = m*sin(p);
+			}
+	}
+	f.ma = pick(ma);
+	f.ph = pick(ph);
+	f.re = pick(re);
+	f.im = pick(im);
+}
+
+// Resamples the heading dependent forces onto headings nhead [deg]. QTF keep their headings
+void Hydro::ResampleHead(const Upp::Vector<double> &nhead) {
+	if (Nh < 1 || nhead.IsEmpty())
+		return;
+	
+	ResampleForcesHead(ex, head, nhead);
+	ResampleForcesHead(sc, head, nhead);
+	ResampleForcesHead(fk, head, nhead);
+	ResampleForcesHead(rao, head, nhead);
+	
+	head = clone(nhead);
+	Nh = head.size();
+}
+
+// Bilinear resampling of the QTF real and imaginary parts onto frequencies nqw.
+// Missing symmetric entries are completed before, so the result is the full (nqw, nqw) grid.
+// Entries that depend on frequency pairs without data are not added
+static void ResampleQTF(Upp::Array<Hydro::QTF> &qtf, int nq, const Interpolator &tab, bool isSum) {
+	VectorMap<Tuple<int, int, int>, Upp::Vector<int>> groups;	// (ib, ih1, ih2)
+	for (int i = 0; i < qtf.size(); ++i)
+		groups.GetAdd(MakeTuple(qtf[i].ib, qtf[i].ih1, qtf[i].ih2)) << i;
+
+	Eigen::Index nnew = tab.GetCount();
+	Upp::Array<Hydro::QTF> res;
+	for (int ig = 0; ig < groups.size(); ++ig) {
+		const Tuple<int, int, int> &key = groups.GetKey(ig);
+		const Upp::Vector<int> &ids = groups[ig];
+
+		Upp::Array<MatrixXd> re(6), im(6);			// Null where there is no data, so it is not interpolated
+		MatrixXi filled = MatrixXi::Zero(nq, nq);
+		for (int idf = 0; idf < 6; ++idf) {
+			re[idf].setConstant(nq, nq, Null);
+			im[idf].setConstant(nq, nq, Null);
+		}
+		Upp::Vector<bool> avail(6, false);
+		for (int id : ids) {
+			const Hydro::QTF &q = qtf[id];
+			filled(q.ifr1, q.ifr2) = 1;
+			for (int idf = 0; idf < 6; ++idf)
+				if (!IsNull(q.fre[idf])) {
+					re[idf](q.ifr1, q.ifr2) = q.fre[idf];
+					im[idf](q.ifr1, q.ifr2) = q.fim[idf];
+					avail[idf] = true;
+				}
+		}
+		for (int r = 0; r < nq; ++r)				// Sum is symmetric and difference is hermitian
+			for (int c = 0; c < nq; ++c)
+				if (!filled(r, c) && filled(c, r))
+					for (int idf = 0; idf < 6; ++idf) {
+						re[idf](r, c) = re[idf](c, r);
+						im[idf](r, c) = isSum ? im[idf](c, r) : -im[idf](c, r);
+					}
+
+		Upp::Array<MatrixXd> nre(6), nim(6);
+		for (int idf = 0; idf < 6; ++idf) {
+			if (!avail[idf])
+				continue;
+			MatrixXd tmp, tmpt;
+			tab.Apply(re[idf], tmp);
+			tab.Apply(MatrixXd(tmp.transpose()), tmpt);
+			nre[idf] = tmpt.transpose();
+			tab.Apply(im[idf], tmp);
+			tab.Apply(MatrixXd(tmp.transpose()), tmpt);
+			nim[idf] = tmpt.transpose();
+		}
+		for (int r = 0; r < nnew; ++r)
+			for (int c = 0; c < nnew; ++c) {
+				Hydro::QTF &q = res.Add();
+				q.Set(key.a, key.b, key.c, r, c);
+				bool isnull = true;
+				for (int idf = 0; idf < 6; ++idf) {
+					if (!avail[idf] || IsNull(nre[idf](r, c)) || IsNull(nim[idf](r, c)))
+						continue;
+					q.fre[idf] = nre[idf](r, c);
+					q.fim[idf] = nim[idf](r, c);
+					q.fma[idf] = sqrt(sqr(q.fre[idf]) + sqr(q.fim[idf]));
+					q.fph[idf] = atan2(q.fim[idf], q.fre[idf]);
+					isnull = false;
+				}
+				if (isnull)
+					res.Drop();
+			}
+	}
+	qtf = pick(res);
+}
+
+void Hydro::ResampleQTFW(const Upp::Vector<double> &nqw) {
+	if (qtfw.size() < 2 || nqw.IsEmpty())
+		return;
+
+	Interpolator lin;
+	lin.Init(Map<const VectorXd>(qtfw, qtfw.size()), Map<const VectorXd>(nqw, nqw.size()), Interpolator::LINEAR);
+
+	::ResampleQTF(qtfsum, qtfw.size(), lin, true);
+	::ResampleQTF(qtfdif, qtfw.size(), lin, false);
+
+	qtfw = clone(nqw);
+	qtfT.SetCount(qtfw.size());
+	for (int i = 0; i < qtfw.size(); ++i)
+		qtfT[i] = qtfw[i] > 0 ? 2*M_PI/qtfw[i] : double(Null);
+}
@@ -0,0 +1,184 @@
+#include "BEMRosetta.h"
+#include "BEMRosetta_int.h"
+#include "functions.h"
+
+using namespace Eigen;
+
+// Gets the response statistics of every DOF for each sea state, from the dimensional RAO.
+// |RAO|² is interpolated once onto a regular spectral grid of numW frequencies, and it is shared by all sea states
+bool Hydro::GetResponseStats(const Upp::Vector<SeaState> &seaStates, Upp::Array<ResponseStats> &stats, int numW) {
+	if (!IsLoadedRAO()) {
+		lastError = t_("RAO are required to get the response statistics");
+		return false;
+	}
+	if (Nf < 2 || numW < 2) {
+		lastError = t_("Not enough frequencies to get the response statistics");
+		return false;
+	}
+	int ndof = 6*Nb;
+	
+	for (const SeaState &sea : seaStates) {
+		int ih0, ih1;
+		double fh;
+		if (!GetHeadingBracket(head, sea.head, ih0, ih1, fh)) {
+			lastError = Format(t_("Sea state heading %.1f deg is out of the model headings"), sea.head);
+			return false;
+		}
+	}
+
+	Upp::Vector<int> idw = GetSortOrder(w);
+	double minW = w[idw[0]], maxW = w[idw.Top()];
+	VectorXd ws = VectorXd::LinSpaced(numW, minW, maxW);
+	double dw = ws[1] - ws[0];
+
+	// Brackets are the same for all headings and DOF
+	Upp::Vector<int> id0(numW), id1(numW);
+	Upp::Vector<double> fw(numW);
+	for (int iw = 0, j = 0; iw < numW; ++iw) {
+		while (j < Nf-2 && w[idw[j+1]] < ws[iw])
+			j++;
+		id0[iw] = idw[j];
+		id1[iw] = idw[j+1];
+		double w0 = w[id0[iw]], w1 = w[id1[iw]];
+		fw[iw] = w1 > w0 ? minmax((ws[iw] - w0)/(w1 - w0), 0., 1.) : 0;
+	}
+
+	Upp::Array<MatrixXd> rao2(Nh);			// [Nh](numW, 6*Nb)
+	for (int ih = 0; ih < Nh; ++ih) {
+		rao2[ih].setConstant(numW, ndof, Null);
+		for (int idf = 0; idf < ndof; ++idf) {
+			if (IsNull(rao.ma[ih](0, idf)))
+				continue;
+			for (int iw = 0; iw < numW; ++iw) {
+				double r0 = R_ma_dim(rao, ih, id0[iw], idf), r1 = R_ma_dim(rao, ih, id1[iw], idf);
+				rao2[ih](iw, idf) = sqr(r0 + fw[iw]*(r1 - r0));
+			}
+		}
+	}
+
+	stats.SetCount(seaStates.size());
+	CoWork co;
+	for (int is = 0; is < seaStates.size(); ++is) {
+		co & [&, is] {
+			const SeaState &sea = seaStates[is];
+			ResponseStats &st = stats[is];
+			st.m0.SetCount(ndof, Null);
+			st.sig.SetCount(ndof, Null);
+			st.mpm.SetCount(ndof, Null);
+
+			// Linear interpolation between the closest headings, wrapping at 360 deg if they cover the circle
+			int ih0, ih1;
+			double fh;
+			GetHeadingBracket(head, sea.head, ih0, ih1, fh);
+
+			VectorXd S(numW);
+			for (int iw = 0; iw < numW; ++iw)
+				S[iw] = JONSWAP(ws[iw], sea.Hs, sea.Tp, sea.gamma);
+
+			for (int idf = 0; idf < ndof; ++idf) {
+				if (IsNull(rao2[ih0](0, idf)) || IsNull(rao2[ih1](0, idf)))
+					continue;
+				VectorXd r2 = rao2[ih0].col(idf) + fh*(rao2[ih1].col(idf) - rao2[ih0].col(idf));
+				VectorXd Sr = r2.cwiseProduct(S);
+				VectorXd Sr2 = Sr.cwiseProduct(ws.cwiseProduct(ws));
+				double m0 = dw*(Sr.sum() - (Sr[0] + Sr[numW-1])/2);
+				double m2 = dw*(Sr2.sum() - (Sr2[0] + Sr2[numW-1])/2);
+				st.m0[idf] = m0;
+				st.sig[idf] = 2*sqrt(m0);						// Significant amplitude
+				if (m0 > 0 && m2 > 0) {
+					double Tz = 2*M_PI*sqrt(m0/m2);
+					double N = sea.duration/Tz;
+					st.mpm[idf] = N > 1 ? sqrt(2*m0*log(N)) : 0;	// Most probable maximum
+				}
+			}
+		};
+	}
+	co.Finish();
+
+	return true;
+}
+
+static int IsCsvSeparator(int c) {
+	return c == ',' || c == ';' || c == '\t' || c == ' ';
+}
+
+// Reads Hs, Tp and optionally gamma, heading and duration. Lines not beginning with a number are skipped
+void Hydro::LoadSeaStates(String fileName, Upp::Vector<SeaState> &seaStates) {
+	FileInLine in(fileName);
+	if (!in.IsOpen())
+		throw Exc(Format(t_("Impossible to open file '%s'"), fileName));
+
+	FieldSplit f(in);
+	f.IsSeparator = IsCsvSeparator;
+
+	seaStates.Clear();
+	while (!in.IsEof()) {
+		f.Load(in.GetLine());
+		if (f.size() < 2 || IsNull(ScanDouble(f.GetText(0))))
+			continue;
+		SeaState &sea = seaStates.Add();
+		sea.Hs = f.GetDouble(0);
+		sea.Tp = f.GetDouble(1);
+		if (f.size() > 2)
+			sea.gamma = f.GetDouble(2);
+		if (f.size() > 3)
+			sea.head = f.GetDouble(3);
+		if (f.size() > 4)
+			sea.duration = f.GetDouble(4);
+	}
+	if (seaStates.IsEmpty())
+		throw Exc(Format(t_("No sea state found in '%s'"), fileName));
+}
+
+// Reads a dimensional matrix, a row per line. Lines not beginning with a number are skipped
+void Hydro::LoadMatrix(String fileName, MatrixXd &m) {
+	FileInLine in(fileName);
+	if (!in.IsOpen())
+		throw Exc(Format(t_("Impossible to open file '%s'"), fileName));
+
+	FieldSplit f(in);
+	f.IsSeparator = IsCsvSeparator;
+
+	Upp::Vector<Upp::Vector<double>> rows;
+	while (!in.IsEof()) {
+		f.Load(in.GetLine());
+		if (f.size() < 1 || IsNull(ScanDouble(f.GetText(0))))
+			continue;
+		Upp::Vector<double> &row = rows.Add();
+		for (int c = 0; c < f.size(); ++c)
+			row << f.GetDouble(c);
+		if (row.size() != rows[0].size())
+			throw Exc(in.Str() + "\n" + Format(t_("Wrong number of columns in '%s'"), fileName));
+	}
+	if (rows.IsEmpty())
+		throw Exc(Format(t_("No matrix found in '%s'"), fileName));
+	
+	m.resize(rows.size(), rows[0].size());
+	for (int r = 0; r < rows.size(); ++r)
+		for (int c = 0; c < rows[r].size(); ++c)
+			m(r, c) = rows[r][c];
+}
+
+void Hydro::SaveResponseStats(String fileName, const Upp::Vector<SeaState> &seaStates, const Upp::Array<ResponseStats> &stats) const {
+	FileOut out(fileName);
+	if (!out.IsOpen())
+		throw Exc(Format(t_("Impossible to open file '%s'"), fileName));
+
+	Upp::Vector<int> dofs;
+	if (!stats.IsEmpty())
+		for (int idf = 0; idf < stats[0].sig.size(); ++idf)
+			if (!IsNull(stats[0].sig[idf]))
+				dofs << idf;
+
+	out << "Hs,Tp,gamma,heading,duration";
+	for (int idf : dofs)
+		out << "," << StrBDOF(idf) << "_m0," << StrBDOF(idf) << "_sig," << StrBDOF(idf) << "_mpm";
+	out << "\n";
+	for (int is = 0; is < seaStates.size(); ++is) {
+		const SeaState &sea = seaStates[is];
+		out << Format("%g,%g,%g,%g,%g", sea.Hs, sea.Tp, sea.gamma, sea.head, sea.duration);
+		for (int idf : dofs)
+			out << Format(",%g,%g,%g", stats[is].m0[idf], stats[is].sig[idf], stats[is].mpm[idf]);
+		out << "\n";
+	}
+}
@@ -0,0 +1,218 @@
+#include "BEMRosetta.h"
+
+HydroCache::HydroCache(const BEMData &md, int _maxModels) : maxModels(_maxModels) {
+	config = StoreAsJson(md);
+}
+
+// Adds to md a copy of the model in file, loading it only if it is not in the cache or it has changed
+void HydroCache::Load(BEMData &md, String file) {
+	file = NormalizePath(file);
+	if (!FileExists(file))
+		throw Exc(Format(t_("File '%s' not found"), file));
+	int64 length = GetFileLength(file);
+	Time time = FileGetTime(file);
+
+	std::shared_ptr<BEMData> data;
+	{
+		Mutex::Lock __(mutex);
+		for (Item &item : items) {
+			if (item.file == file && item.length == length && item.time == time) {
+				item.lastUse = ++useCount;
+				data = item.md;
+				break;
+			}
+		}
+	}
+	if (!data) {
+		data = std::make_shared<BEMData>();
+		LoadFromJson(*data, config);
+		data->Load(file, [](String, int) {return true;}, false);
+
+		Mutex::Lock __(mutex);
+		for (int i = items.size()-1; i >= 0; --i)		// Old versions of the file are not useful anymore
+			if (items[i].file == file)
+				items.Remove(i);
+		Item &item = items.Add();
+		item.file = file;
+		item.length = length;
+		item.time = time;
+		item.lastUse = ++useCount;
+		item.md = data;
+		while (items.size() > maxModels) {
+			int idmin = 0;
+			for (int i = 1; i < items.size(); ++i)
+				if (items[i].lastUse < items[idmin].lastUse)
+					idmin = i;
+			items.Remove(idmin);
+		}
+	}
+
+	const Hydro &src = data->hydros[0].hd();
+	HydroClass &hydro = md.hydros.Create<HydroClass>(md);
+	hydro.hd().Copy(src);
+
+	if (md.hydros.size() == 1 || src.Nb > md.Nb)
+		md.Nb = src.Nb;
+	for (int i = 0; i < src.head.size(); ++i)
+		FindAddRatio(md.headAll, src.head[i], 0.01);
+	Sort(md.headAll);
+}
+
+// The server writes a random key in a file only readable by the user, and clients have to send it,
+// so other users cannot run commands, that read and write files, as the server user
+static String GetServerKeyFile(int port) {
+	return AppendFileNameX(GetAppDataFolder(), "BEMRosetta", Format("server_%d.key", port));
+}
+
+static String CreateServerKey(int port) {
+	String fileName = GetServerKeyFile(port);
+	if (!RealizePath(fileName))
+		throw Exc(Format(t_("Impossible to create folder for '%s'"), fileName));
+	FileDelete(fileName);
+	FileOut out;
+#ifdef PLATFORM_POSIX
+	bool opened = out.Open(fileName, 0600);
+#else
+	bool opened = out.Open(fileName);			// User app data folder is private
+#endif
+	if (!opened)
+		throw Exc(Format(t_("Impossible to open file '%s'"), fileName));
+	String key = Uuid::Create().ToString() + Uuid::Create().ToString();
+	out << key;
+	return key;
+}
+
+// Request is the server key, the number of arguments and then an argument per line. Answer is the output text
+static void ServeRequest(TcpSocket &socket, HydroCache &cache, const String &config, const String &key) {
+	socket.Timeout(60000);
+	if (socket.GetLine() != key)
+		return;
+	int num = ScanInt(socket.GetLine());
+	if (IsNull(num) || num < 0 || num > 10000)
+		return;
+	Upp::Vector<String> command;
+	for (int i = 0; i < num && !socket.IsError(); ++i)
+		command << socket.GetLine();
+	if (socket.IsError())
+		return;
+
+	BEMData md;
+	LoadFromJson(md, config);
+
+	StringStream out;
+	Stream *prevOut = SetConsoleOut(&out);
+	ConsoleProcess(md, command, false, &cache);
+	SetConsoleOut(prevOut);
+
+	socket.Timeout(Null);
+	socket.PutAll(out.GetResult());
+	socket.Close();
+}
+
+// Serves requests from local clients, each one in its own thread, until the process is ended.
+// Up to the number of cores are served at the same time. The rest wait to be accepted
+void RunServer(BEMData &md, int port) {
+	HydroCache cache(md);
+	String config = StoreAsJson(md);
+	String key = CreateServerKey(port);
+
+	IpAddrInfo ip;
+	ip.Execute("127.0.0.1", port);
+	TcpSocket server;
+	if (!server.Listen(ip, port, 10))
+		throw Exc(Format(t_("Impossible to listen on port %d: %s"), port, server.GetErrorDesc()));
+
+	ConsoleOut() << "\n" << Format(t_("Server listening on 127.0.0.1:%d"), port);
+	ConsoleOut().Flush();
+
+	const int maxWorkers = CPU_Cores();
+	std::atomic<int> numWorkers(0);
+	while (!Thread::IsShutdownThreads()) {
+		while (numWorkers >= maxWorkers)
+			Sleep(10);
+		TcpSocket *socket = new TcpSocket();
+		if (!socket->Accept(server)) {
+			delete socket;
+			continue;
+		}
+		numWorkers++;
+		Thread::Start([socket, &cache, &config, &key, &numWorkers] {
+			One<TcpSocket> s;
+			s.Attach(socket);
+			ServeRequest(*s, cache, config, key);
+			numWorkers--;
+		});
+	}
+	while (numWorkers > 0)
+		Sleep(10);
+	FileDelete(GetServerKeyFile(port));
+}
+
+// Relative file names are got from the client folder, as server may be running in other
+static void AbsolutePaths(Upp::Vector<String> &command) {
+	auto Abs = [&](int i) {
+		if (i < command.size() && !IsFullPath(command[i]))
+			command[i] = NormalizePath(command[i]);
+	};
+	auto AbsMatrices = [&](int &i) {		// "M|Dlin|Dquad|Cmoor <matrix file>" pairs
+		while (i+2 < command.size() && (command[i+1] == "M" || command[i+1] == "Dlin" || 
+										command[i+1] == "Dquad" || command[i+1] == "Cmoor")) {
+			i++;
+			Abs(++i);
+		}
+	};
+	for (int i = 0; i < command.size(); ++i) {
+		const String &c = command[i];
+		if (c == "-i" || c == "--input" || c == "-c" || c == "--convert")
+			Abs(++i);
+		else if (c == "-pf" || c == "--profile") {
+			if (i+1 < command.size() && !command[i+1].StartsWith("-"))
+				Abs(++i);
+		} else if (c == "-rs" || c == "--response") {
+			Abs(++i);
+			Abs(++i);
+		} else if (c == "-ra" || c == "--rao") 
+			AbsMatrices(i);
+		else if (c == "-td" || c == "--timedomain" || c == "-ts" || c == "--timeseries") {
+			bool timeDomain = c == "-td" || c == "--timedomain";
+			Abs(++i);
+			i += 2;				// Duration and time step
+			Abs(++i);
+			if (timeDomain)
+				AbsMatrices(i);
+		} else if (c == "-gz" || c == "--gz") {
+			Abs(++i);
+			i += 5;				// Mass and cg
+			Abs(++i);
+		} else if (c == "-mc" || c == "--meshcache") 
+			Abs(++i);
+		else if (c == "-b" || c == "--batch") {
+			Abs(++i);
+			++i;				// Extension
+			if (i+1 < command.size() && !command[i+1].StartsWith("-"))
+				Abs(++i);
+		}
+	}
+}
+
+void RunClient(const Upp::Vector<String> &_command, int port) {
+	Upp::Vector<String> command = clone(_command);
+	AbsolutePaths(command);
+
+	String key = LoadFile(GetServerKeyFile(port));
+	if (key.IsEmpty())
+		throw Exc(Format(t_("Server key for port %d not found. Is the server running?"), port));
+	
+	TcpSocket socket;
+	if (!socket.Connect("127.0.0.1", port))
+		throw Exc(Format(t_("Impossible to connect to server in port %d. Is it running?"), port));
+
+	String request = key + "\n" + Format("%d\n", command.size());
+	for (const String &c : command)
+		request << c << "\n";
+	if (!socket.PutAll(request))
+		throw Exc(Format(t_("Problem sending request to server: %s"), socket.GetErrorDesc()));
+
+	while (!socket.IsEof() && !socket.IsError())
+		ConsoleOut() << socket.Get(4096);
+}
@@ -0,0 +1,141 @@
+#include "BEMRosetta.h"
+
+using namespace Eigen;
+
+static inline void Transform(Point3D &p, const Matrix3d &R, const Vector3d &t) {
+	Vector3d v = R*Vector3d(p.x, p.y, p.z) + t;
+	p = Point3D(v(0), v(1), v(2));
+}
+
+// Finds by Newton iteration the heave, roll (heel) and pitch (trim) where buoyancy balances the weight,
+// moving mesh and cg there. The hydrostatic stiffness is the Jacobian. Returns the number of iterations
+int MeshData::Equilibrium(double rho, double g, int maxIter, double tolerance) {
+	BEM_PROFILE("MeshData::Equilibrium");
+
+	if (IsNull(mass) || mass <= 0)
+		throw Exc(t_("Mass has to be set to get the equilibrium"));
+
+	double weight = mass*g;
+	double len = max(mesh.env.maxX - mesh.env.minX, mesh.env.maxY - mesh.env.minY);
+	MeshSoA soa(mesh);
+	MatrixXd C;
+	int iter;
+	for (iter = 0; iter < maxIter; ++iter) {
+		double vol = hs.GetUnderVolume();
+		if (vol <= 0 || hs.wpArea <= 0)
+			throw Exc(t_("Mesh has to cross the water line to get the equilibrium"));
+		Point3D cbi = hs.GetCb();
+
+		// Vertical force and moments around x and y
+		Vector3d F(rho*g*vol - weight, rho*g*vol*cbi.y - weight*cg.y, -rho*g*vol*cbi.x + weight*cg.x);
+		if (abs(F(0)) < tolerance*weight && abs(F(1)) < tolerance*weight*len && abs(F(2)) < tolerance*weight*len)
+			break;
+
+		hs.GetC(C, rho, g, cg, mass);
+		Matrix3d J = C.block<3, 3>(2, 2);
+		LLT<Matrix3d> llt(J);
+		if (llt.info() != Success)
+			throw Exc(t_("Mesh is unstable in roll or pitch. Equilibrium cannot be found"));
+		Vector3d d = llt.solve(F);
+
+		Matrix3d R = (AngleAxisd(d(1), Vector3d::UnitX())*AngleAxisd(d(2), Vector3d::UnitY())).toRotationMatrix();
+		Vector3d t(0, 0, d(0));
+		soa.Transform(R, t);
+		soa.Save(mesh);
+		Transform(cg, R, t);
+		hs.Move(soa, R, t);
+	}
+	if (iter == maxIter)
+		throw Exc(Format(t_("Equilibrium not found after %d iterations"), maxIter));
+
+	AfterLoad(rho, g, false);
+	return iter;
+}
+
+// Heels the mesh around cg by each angle in heels, around an horizontal axis in each of the headings [deg]
+// (0 is heel around x axis), and sinks it to keep the displacement, getting the righting arm GZ and the stiffness.
+// All cases copy the mesh nodes and only clip and integrate their own copy. They are processed in parallel
+void MeshData::GetGZ(const Upp::Vector<double> &headings, const Upp::Vector<double> &heels, double rho, double g,
+					Upp::Array<GZCase> &cases) const {
+	BEM_PROFILE("MeshData::GetGZ");
+
+	if (IsNull(mass) || mass <= 0)
+		throw Exc(t_("Mass has to be set to get GZ"));
+
+	double vol0 = mass/rho;
+	double height = mesh.env.maxZ - mesh.env.minZ;
+	Vector3d vcg(cg.x, cg.y, cg.z);
+	MeshSoA soa0(mesh);
+
+	cases.SetCount(headings.size()*heels.size());
+	CoWork co;
+	for (int ih = 0; ih < headings.size(); ++ih) {
+		for (int ie = 0; ie < heels.size(); ++ie) {
+			co & [&, ih, ie] {
+				GZCase &c = cases[ih*heels.size() + ie];
+				c.heading = headings[ih];
+				c.heel = heels[ie];
+
+				double beta = ToRad(c.heading);
+				Vector3d axis(cos(beta), sin(beta), 0);
+				Matrix3d R = AngleAxisd(ToRad(c.heel), axis).toRotationMatrix();
+				Vector3d t = vcg - R*vcg;
+
+				MeshSoA soa = soa0;
+				soa.Transform(R, t);
+				Hydrostatics h;
+				h.Get(soa);
+
+				// Newton iteration in heave, with the water plane area as Jacobian
+				double heave = 0;
+				bool converged = false;
+				for (int iter = 0; iter < 100; ++iter) {
+					double dvol = h.GetUnderVolume() - vol0;
+					if (abs(dvol) < 1E-8*vol0) {
+						converged = true;
+						break;
+					}
+					if (h.wpArea <= 0)
+						break;
+					double dz = minmax(dvol/h.wpArea, -height, height);
+					soa.Translate(0, 0, dz);
+					h.Move(soa, Matrix3d::Identity(), Vector3d(0, 0, dz));
+					heave += dz;
+				}
+				if (!converged)
+					return;
+
+				Point3D cgc(cg.x, cg.y, cg.z + heave);
+				c.heave = heave;
+				c.cb = h.GetCb();
+				c.gz = (cgc.x - c.cb.x)*(-sin(beta)) + (cgc.y - c.cb.y)*cos(beta);
+				h.GetC(c.C, rho, g, cgc, mass);
+			};
+		}
+	}
+	co.Finish();
+}
+
+void MeshData::SaveGZ(String fileName, const Upp::Array<GZCase> &cases) {
+	FileOut out(fileName);
+	if (!out.IsOpen())
+		throw Exc(Format(t_("Impossible to open file '%s'"), fileName));
+
+	const int ids[][2] = {{2, 2}, {2, 3}, {2, 4}, {3, 3}, {3, 4}, {3, 5}, {4, 4}, {4, 5}};
+	
+	out << "heading,heel,heave,GZ,cb_x,cb_y,cb_z";
+	for (const auto &id : ids)
+		out << Format(",C%d%d", id[0]+1, id[1]+1);
+	out << "\n";
+	for (const GZCase &c : cases) {
+		out << Format("%g,%g", c.heading, c.heel);
+		if (IsNull(c.heave))			// Not converged
+			out << String(',', 5 + __countof(ids));
+		else {
+			out << Format(",%g,%g,%g,%g,%g", c.heave, c.gz, c.cb.x, c.cb.y, c.cb.z);
+			for (const auto &id : ids)
+				out << Format(",%g", c.C(id[0], id[1]));
+		}
+		out << "\n";
+	}
+}
@@ -0,0 +1,325 @@
+#include "BEMRosetta.h"
+
+using namespace Eigen;
+
+typedef std::complex<double> Complex;
+
+static Complex PolyVal(const VectorXd &p, Complex s) {
+	Complex ret = 0;
+	for (Eigen::Index i = p.size()-1; i >= 0; --i)
+		ret = ret*s + p(i);
+	return ret;
+}
+
+// Least squares fit of the numerator N(s) = b1·s + ... + b(n-1)·s^(n-1), with fixed denominator
+static void FitNumerator(const Upp::Vector<Complex> &s, const Upp::Vector<Complex> &H, const VectorXd &den, VectorXd &num) {
+	int nf = s.size();
+	int n = int(den.size()) - 1;
+	MatrixXd M(2*nf, n-1);
+	VectorXd rhs(2*nf);
+	for (int k = 0; k < nf; ++k) {
+		Complex d = PolyVal(den, s[k]);
+		Complex sp = s[k];
+		for (int i = 0; i < n-1; ++i) {
+			Complex v = sp/d;
+			M(2*k, i)   = v.real();
+			M(2*k+1, i) = v.imag();
+			sp *= s[k];
+		}
+		rhs(2*k)   = H[k].real();
+		rhs(2*k+1) = H[k].imag();
+	}
+	num = VectorXd::Zero(n);
+	num.tail(n-1) = M.colPivHouseholderQr().solve(rhs);
+}
+
+// Sanathanan-Koerner iterations to fit H(s) = N(s)/D(s), D(s) monic of order n.
+// N(0) = 0 as radiation kernel has a zero at s = 0
+static void FitRational(const Upp::Vector<Complex> &s, const Upp::Vector<Complex> &H, int n, VectorXd &num, VectorXd &den) {
+	int nf = s.size();
+	int nb = n-1;
+	MatrixXd M(2*nf, nb + n);
+	VectorXd rhs(2*nf);
+	VectorXd weight = VectorXd::Ones(nf);
+
+	den = VectorXd::Zero(n+1);
+	den(n) = 1;
+	for (int iter = 0; iter < 30; ++iter) {
+		for (int k = 0; k < nf; ++k) {
+			Complex sk = s[k], hk = H[k];
+			double wk = weight(k);
+			Complex sp = sk;
+			for (int i = 0; i < nb; ++i) {
+				Complex v = sp*wk;
+				M(2*k, i)   = v.real();
+				M(2*k+1, i) = v.imag();
+				sp *= sk;
+			}
+			sp = 1;
+			for (int i = 0; i < n; ++i) {
+				Complex v = -hk*sp*wk;
+				M(2*k, nb+i)   = v.real();
+				M(2*k+1, nb+i) = v.imag();
+				sp *= sk;
+			}
+			Complex r = hk*sp*wk;
+			rhs(2*k)   = r.real();
+			rhs(2*k+1) = r.imag();
+		}
+		VectorXd x = M.colPivHouseholderQr().solve(rhs);
+
+		VectorXd denOld = den;
+		den.head(n) = x.tail(n);
+		for (int k = 0; k < nf; ++k) {
+			double ad = abs(PolyVal(den, s[k]));
+			weight(k) = ad > 0 ? 1/ad : 1;
+		}
+		if ((den - denOld).norm() < 1E-10*(1 + den.norm()))
+			break;
+	}
+	num = VectorXd::Zero(n);
+	FitNumerator(s, H, den, num);
+}
+
+// Reflects the unstable poles to the left half plane. Returns true if any pole was changed
+static bool Stabilize(VectorXd &den) {
+	int n = int(den.size()) - 1;
+	MatrixXd comp = MatrixXd::Zero(n, n);
+	for (int i = 0; i < n; ++i)
+		comp(0, i) = -den(n-1-i);
+	for (int i = 1; i < n; ++i)
+		comp(i, i-1) = 1;
+
+	VectorXcd poles = EigenSolver<MatrixXd>(comp, false).eigenvalues();
+	bool changed = false;
+	for (Eigen::Index i = 0; i < poles.size(); ++i) {
+		if (poles(i).real() >= 0) {
+			poles(i) = Complex(-std::max(abs(poles(i).real()), 1E-6*abs(poles(i))), poles(i).imag());
+			changed = true;
+		}
+	}
+	if (!changed)
+		return false;
+
+	VectorXcd p = VectorXcd::Zero(n+1);
+	p(0) = 1;
+	for (int i = 0; i < n; ++i) {		// p(s) = Π(s - pole_i)
+		for (int j = i+1; j > 0; --j)
+			p(j) = p(j-1) - poles(i)*p(j);
+		p(0) = -poles(i)*p(0);
+	}
+	den = p.real();
+	return true;
+}
+
+static double FitError(const Upp::Vector<Complex> &s, const Upp::Vector<Complex> &H, const VectorXd &num, const VectorXd &den) {
+	double err = 0, mx = 0;
+	for (int k = 0; k < s.size(); ++k) {
+		err += abs(PolyVal(num, s[k])/PolyVal(den, s[k]) - H[k]);
+		mx = std::max(mx, abs(H[k]));
+	}
+	if (mx == 0)
+		return 0;
+	return err/s.size()/mx;
+}
+
+// Identifies the radiation state space of every DOF pair from K(jω) = B(ω) + jω(A(ω) - A∞).
+// Order is increased up to maxOrder until the relative MAE is below maxError
+bool Hydro::GetStateSpace(double fromW, double toW, int maxOrder, double maxError, Function <bool(String, int)> Status) {
+	if (!IsLoadedA() || !IsLoadedB() || !IsLoadedAwinf()) {
+		lastError = t_("A, B and A∞ are required to get the state space");
+		return false;
+	}
+	if (maxOrder < 2) {
+		lastError = t_("State space order has to be 2 or higher");
+		return false;
+	}
+
+	Upp::Vector<int> idfs, jdfs;
+	for (int idf = 0; idf < 6*Nb; ++idf)
+		for (int jdf = 0; jdf < 6*Nb; ++jdf)
+			if (!IsNull(A[idf][jdf][0]) && !IsNull(B[idf][jdf][0]) && !IsNull(Awinf(idf, jdf))) {
+				idfs << idf;
+				jdfs << jdf;
+			}
+	if (idfs.IsEmpty()) {
+		lastError = t_("No DOF available to get the state space");
+		return false;
+	}
+
+	Upp::Vector<int> ifrs;
+	double maxW = 0;
+	for (int ifr = 0; ifr < Nf; ++ifr)
+		if (w[ifr] > 0 && (IsNull(fromW) || w[ifr] >= fromW) && (IsNull(toW) || w[ifr] <= toW)) {
+			ifrs << ifr;
+			maxW = max(maxW, w[ifr]);
+		}
+	if (ifrs.size() < 2*maxOrder) {
+		lastError = t_("Not enough frequencies to get the state space");
+		return false;
+	}
+
+	if (!Status(Format(t_("Getting state space of %d DOF pairs"), idfs.size()), 10)) {
+		lastError = t_("Cancelled by user");
+		return false;
+	}
+
+	Upp::Vector<Complex> s(ifrs.size());
+	for (int k = 0; k < ifrs.size(); ++k)
+		s[k] = Complex(0, w[ifrs[k]]/maxW);		// Scaled frequencies for a better conditioning
+
+	double factor = g_rho_ndim()/g_rho_dim();	// sts are saved with the rho and g of the model
+
+	sts.Clear();
+	InitializeSts();
+
+	try {
+		CoWork co;
+		for (int ip = 0; ip < idfs.size(); ++ip) {
+			co & [&, ip] {
+				int idf = idfs[ip], jdf = jdfs[ip];
+
+				Upp::Vector<Complex> H(ifrs.size());
+				double hs = 0;
+				for (int k = 0; k < ifrs.size(); ++k) {
+					H[k] = Z(false, ifrs[k], idf, jdf)*factor;
+					hs = max(hs, abs(H[k]));
+				}
+				if (hs == 0)
+					return;
+				for (int k = 0; k < H.size(); ++k)
+					H[k] /= hs;
+
+				VectorXd num, den, bestNum, bestDen;
+				double bestErr = DBL_MAX;
+				for (int n = 2; n <= maxOrder; ++n) {
+					FitRational(s, H, n, num, den);
+					if (Stabilize(den))
+						FitNumerator(s, H, den, num);
+					double err = FitError(s, H, num, den);
+					if (err < bestErr) {
+						bestErr = err;
+						bestNum = num;
+						bestDen = den;
+					}
+					if (err <= maxError)
+						break;
+				}
+
+				// Controllable canonical form, unscaled from s' = s/maxW
+				int n = int(bestDen.size()) - 1;
+				StateSpace &st = sts[idf][jdf];
+				st.A_ss = MatrixXd::Zero(n, n);
+				for (int i = 0; i < n-1; ++i)
+					st.A_ss(i, i+1) = maxW;
+				for (int i = 0; i < n; ++i)
+					st.A_ss(n-1, i) = -bestDen(i)*maxW;
+				st.B_ss = VectorXd::Zero(n);
+				st.B_ss(n-1) = maxW;
+				st.C_ss = bestNum*hs;
+				st.ssMAE = bestErr;
+				st.ssFreqRange.resize(2);
+				st.ssFreqRange << w[ifrs[0]], w[ifrs.Top()];
+				st.GetTFS(w);
+			};
+		}
+		co.Finish();
+	} catch (Exc e) {
+		lastError = e;
+		return false;
+	}
+	dimenSTS = true;
+	stsProcessor = "BEMRosetta";
+
+	Status(t_("State space obtained"), 100);
+	return true;
+}
+
+// Solves M·x = b, with M upper Hessenberg, in O(n²) by Gaussian elimination with adjacent row pivoting
+static void HessenbergSolve(MatrixXcd &M, VectorXcd &b) {
+	Eigen::Index n = M.rows();
+	for (Eigen::Index k = 0; k < n-1; ++k) {
+		if (abs(M(k+1, k)) > abs(M(k, k))) {
+			M.row(k).tail(n-k).swap(M.row(k+1).tail(n-k));
+			std::swap(b(k), b(k+1));
+		}
+		if (M(k, k) == 0.)
+			continue;
+		Complex f = M(k+1, k)/M(k, k);
+		M.row(k+1).tail(n-k) -= f*M.row(k).tail(n-k);
+		b(k+1) -= f*b(k);
+	}
+	for (Eigen::Index k = n-1; k >= 0; --k) {
+		Complex sum = b(k);
+		for (Eigen::Index j = k+1; j < n; ++j)
+			sum -= M(k, j)*b(j);
+		b(k) = sum/M(k, k);
+	}
+}
+
+// Transfer function C_ss·inv(iω·I - A_ss)·B_ss for all frequencies w.
+// A_ss is diagonalised once, so each frequency is got in O(n) as Σ (C_ss·v_k)·(V⁻¹·B_ss)_k/(iω - λ_k).
+// If the eigenvectors are ill conditioned, A_ss is reduced to Hessenberg form instead.
+// Nothing is done if A_ss, B_ss, C_ss and w are the same as in the last call
+void Hydro::StateSpace::GetTFS(const Upp::Vector<double> &w) {
+	Map<const VectorXd> ww(w, w.size());
+	auto Same = [](const auto &a, const auto &b)->bool {
+		return a.rows() == b.rows() && a.cols() == b.cols() && a == b;
+	};
+	if (TFS.size() == w.size() && Same(tfsW, ww) && Same(tfsA, A_ss) && Same(tfsB, B_ss) && Same(tfsC, C_ss))
+		return;
+	
+	Eigen::Index sz = A_ss.rows();
+	TFS.SetCount(w.size(), Complex(0));
+	if (sz == 0 || B_ss.size() != sz || C_ss.size() != sz)
+		return;
+	
+	bool done = false;
+	EigenSolver<MatrixXd> es(A_ss);
+	if (es.info() == Success) {
+		const MatrixXcd &V = es.eigenvectors();
+		const VectorXcd &lambda = es.eigenvalues();
+		PartialPivLU<MatrixXcd> lu(V);
+		if (lu.rcond() > 1E-10) {
+			VectorXcd res = (C_ss.cast<Complex>().transpose()*V).transpose().cwiseProduct(lu.solve(B_ss.cast<Complex>()));
+			for (int ifr = 0; ifr < w.size(); ++ifr) {
+				Complex s(0, w[ifr]), sum = 0;
+				for (Eigen::Index k = 0; k < sz; ++k)
+					sum += res(k)/(s - lambda(k));
+				TFS[ifr] = sum;
+			}
+			done = true;
+		}
+	}
+	if (!done) {
+		HessenbergDecomposition<MatrixXd> hs(A_ss);
+		MatrixXd Q = hs.matrixQ();
+		MatrixXd Hr = hs.matrixH();
+		MatrixXcd H = -Hr.cast<Complex>();
+		VectorXcd b = (Q.transpose()*B_ss).cast<Complex>();
+		RowVectorXcd c = (C_ss.transpose()*Q).cast<Complex>();
+		for (int ifr = 0; ifr < w.size(); ++ifr) {
+			MatrixXcd M = H;
+			M.diagonal().array() += Complex(0, w[ifr]);
+			VectorXcd x = b;
+			HessenbergSolve(M, x);
+			TFS[ifr] = (c*x)(0);
+		}
+	}
+	tfsW = ww;
+	tfsA = A_ss;
+	tfsB = B_ss;
+	tfsC = C_ss;
+}
+
+// Gets the transfer function of all DOF pairs with state space matrices, in parallel
+void Hydro::GetTFS(const Upp::Vector<double> &w) {
+	CoWork co;
+	for (int idf = 0; idf < sts.size(); ++idf)
+		for (int jdf = 0; jdf < sts[idf].size(); ++jdf) 
+			if (sts[idf][jdf].A_ss.size() > 0)
+				co & [&, idf, jdf] {
+					sts[idf][jdf].GetTFS(w);
+				};
+	co.Finish();
+}
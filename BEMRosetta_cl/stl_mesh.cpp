@@ -0,0 +1,35 @@
+#include "BEMRosetta.h"
+#include "BEMRosetta_int.h"
+
+
+// Reads the facets from the file mapped in memory, welding their nodes as they are added
+String MeshData::LoadStlBin(String fileName) {
+	FileMapping map;
+	if (!map.Open(fileName) || map.GetFileSize() < 84 || !map.Map(0, size_t(map.GetFileSize())))
+		return Format(t_("Impossible to open file '%s'"), fileName);
+
+	this->fileName = fileName;
+	SetCode(MeshData::STL_BIN);
+
+	const byte *data = map.Begin();
+	header = TrimRight(String((const char *)data, int(strnlen((const char *)data, 80))));
+	int numFacets = Peek32le(data + 80);
+	if (84 + 50*int64(numFacets) > map.GetFileSize())
+		return t_("Parsing error: ") + Format(t_("Wrong number of facets %d in binary .stl file"), numFacets);
+
+	mesh.Clear();
+	mesh.panels.Reserve(numFacets);
+	mesh.nodes.Reserve(numFacets/2 + 2);		// Closed triangle meshes have around half nodes than facets
+	NodeWelder welder(mesh.nodes, 0);
+
+	const byte *facet = data + 84;
+	for (int i = 0; i < numFacets; ++i, facet += 50) {
+		float v[9];
+		memcpy(v, facet + 12, sizeof(v));		// After the normal
+		Panel &panel = mesh.panels.Add();
+		for (int j = 0; j < 3; ++j)
+			panel.id[j] = welder.Add(Point3D(v[3*j], v[3*j+1], v[3*j+2]));
+		panel.id[3] = panel.id[0];
+	}
+	return String();
+}
@@ -0,0 +1,307 @@
+#include "BEMRosetta.h"
+#include "functions.h"
+#include <plugin/Eigen/unsupported/Eigen/FFT>
+#include <random>
+
+using namespace Eigen;
+
+typedef std::complex<double> Complex;
+
+// Gets the dimensional excitation force for heading hd, interpolated on frequencies wk.
+// Returns (wk.size(), 6*Nb), zero out of the frequency range or in unavailable DOF.
+// hd has to be in the model headings, as checked with GetHeadingBracket()
+void Hydro::GetFexOnGrid(double hd, const VectorXd &wk, MatrixXcd &fex) const {
+	int ndof = 6*Nb;
+	fex.setZero(wk.size(), ndof);
+
+	int ih0, ih1;
+	double fh;
+	GetHeadingBracket(head, hd, ih0, ih1, fh);
+
+	Interpolator lin;
+	lin.Init(Get_w(), wk);
+	VectorXd ma(Nf), ph(Nf), nma(wk.size()), nph(wk.size());
+	for (int idf = 0; idf < ndof; ++idf) {
+		for (int i = 0; i < 2; ++i) {
+			int ih = i == 0 ? ih0 : ih1;
+			double factor = i == 0 ? 1 - fh : fh;
+			if (factor == 0 || IsNull(ex.ma[ih](0, idf)))
+				continue;
+			for (int ifr = 0; ifr < Nf; ++ifr) {
+				ma(ifr) = F_ma_dim(ex, ih, ifr, idf);
+				ph(ifr) = ex.ph[ih](ifr, idf);
+			}
+			lin.Apply(ma, nma);
+			lin.ApplyPhase(ph, nph);
+			for (Eigen::Index k = 0; k < wk.size(); ++k)
+				if (!IsNull(nma(k)))
+					fex(k, idf) += factor*std::polar(nma(k), nph(k));
+		}
+	}
+}
+
+// Wave excitation force time series by inverse FFT, for the sea state spectrum spread in heads with weights.
+// The series is delivered in chunks to WhenChunk(t0, f(num, 6*Nb)). Each chunk is an independent periodic
+// realisation of segLength seconds, joined to the previous one with a power preserving crossfade.
+// If numExtra > 0, WhenSegment(waves, extra) gets the wave components of each segment for the first heading, 
+// and returns in extra (N, numExtra) other forces for the same waves, as the slow drift forces. N is 2*waves.amp.size(). 
+// They are crossfaded and delivered in WhenChunk after the 6*Nb excitation force columns.
+// DOF are processed in parallel
+bool Hydro::GetFexTimeSeries(const SeaState &sea, const Upp::Vector<double> &_heads, const Upp::Vector<double> &_weights,
+				double dt, double duration, double segLength, unsigned seed,
+				Function <void(double, const MatrixXd &)> WhenChunk, 
+				int numExtra, Function <bool(const WaveComponents &, MatrixXd &)> WhenSegment) {
+	if (!IsLoadedFex()) {
+		lastError = t_("Excitation forces are required to get its time series");
+		return false;
+	}
+	if (dt <= 0 || duration <= 0) {
+		lastError = t_("Wrong time step or duration");
+		return false;
+	}
+	Upp::Vector<double> heads, weights;
+	if (_heads.IsEmpty()) {
+		heads << sea.head;
+		weights << 1;
+	} else {
+		heads = clone(_heads);
+		weights = clone(_weights);
+		if (weights.size() != heads.size())
+			weights.SetCount(heads.size(), 1);
+		double sum = 0;
+		for (double wh : weights)
+			sum += wh;
+		for (double &wh : weights)
+			wh /= sum;
+	}
+	for (double hd : heads) {
+		int ih0, ih1;
+		double fh;
+		if (!GetHeadingBracket(head, hd, ih0, ih1, fh)) {
+			lastError = Format(t_("Wave heading %.1f deg is out of the model headings"), hd);
+			return false;
+		}
+	}
+	int ndof = 6*Nb;
+	int nhead = heads.size();
+
+	int N = 16;
+	while (N*dt < min(segLength, duration + dt))
+		N *= 2;
+	int nov = N < int(duration/dt) ? N/8 : 0;	// Crossfade samples
+	int step = N - nov;
+	double dw = 2*M_PI/(N*dt);
+	int nk = N/2;
+
+	VectorXd wk = VectorXd::LinSpaced(nk, 0, (nk-1)*dw);
+	Upp::Array<MatrixXcd> fex(nhead);			// Force transfer functions are got only once for all chunks
+	VectorXd amp(nk);
+	for (int ih = 0; ih < nhead; ++ih)
+		GetFexOnGrid(heads[ih], wk, fex[ih]);
+	for (int k = 0; k < nk; ++k)
+		amp(k) = k == 0 ? 0 : sqrt(2*JONSWAP(wk(k), sea.Hs, sea.Tp, sea.gamma)*dw);
+
+	std::mt19937_64 gen(seed);
+	std::uniform_real_distribution<double> dist(0, 2*M_PI);
+
+	Eigen::Index numTotal = Eigen::Index(duration/dt) + 1;
+	MatrixXd seg(N, ndof + numExtra), tail, extra;
+	WaveComponents waves;
+	MatrixXd phi(nk, nhead);
+	MatrixXcd phases(nk, nhead);
+	for (Eigen::Index t0 = 0, iseg = 0; t0 < numTotal; t0 += step, ++iseg) {
+		for (int ih = 0; ih < nhead; ++ih)
+			for (int k = 0; k < nk; ++k) {
+				phi(k, ih) = dist(gen);
+				phases(k, ih) = std::polar(amp(k)*sqrt(weights[ih]), phi(k, ih));
+			}
+		if (numExtra > 0) {
+			waves.dw = dw;
+			waves.amp = amp*sqrt(weights[0]);
+			waves.phi = phi.col(0);
+			if (!WhenSegment(waves, extra))
+				return false;
+			if (extra.rows() != N || extra.cols() != numExtra) {
+				lastError = t_("Wrong size of the forces added to the excitation");
+				return false;
+			}
+			seg.rightCols(numExtra) = extra;
+		}
+
+		CoWork co;
+		for (int idf = 0; idf < ndof; ++idf) {
+			co & [&, idf] {
+				VectorXcd spec = VectorXcd::Zero(N), res;
+				for (int ih = 0; ih < nhead; ++ih)
+					spec.head(nk) += fex[ih].col(idf).cwiseProduct(phases.col(ih));
+				FFT<double> fft;
+				fft.inv(res, spec);
+				seg.col(idf) = N*res.real();		// Re(Σ a·X·exp(i(ωt + φ)))
+			};
+		}
+		co.Finish();
+
+		if (iseg > 0)
+			for (int j = 0; j < nov; ++j) {
+				double th = (j + 0.5)/nov*M_PI/2;
+				seg.row(j) = cos(th)*tail.row(j) + sin(th)*seg.row(j);
+			}
+		Eigen::Index num = min(Eigen::Index(step), numTotal - t0);
+		WhenChunk(t0*dt, seg.topRows(num));
+		if (nov > 0)
+			tail = seg.bottomRows(nov);
+	}
+	return true;
+}
+
+// Slow drift force time series of body ib from the difference frequency QTF at heading head, for the wave 
+// components got by GetFexTimeSeries(). F(t) = Σj Σk aj·ak·Re[T(ωj, ωk)·exp(i((ωj-ωk)t + φj-φk))]
+// - newman: T(ωj, ωk) ≈ √(T(ωj, ωj)·T(ωk, ωk)), so F is got from the squared envelope in O(N)
+// - full:   terms with the same difference frequency ωj-ωk are accumulated first, up to maxDiffW, so the
+//   double sum needs a single inverse FFT
+// Returns f(num, 6). DOF are processed in parallel
+bool Hydro::GetSlowDriftTimeSeries(const WaveComponents &waves, double head, int ib, double dt, double duration, 
+				bool newman, double maxDiffW, MatrixXd &f) {
+	if (qtfdif.IsEmpty() || qtfw.size() < 2) {
+		lastError = t_("Difference frequency QTF are required to get the slow drift forces");
+		return false;
+	}
+	if (dt <= 0 || duration <= 0) {
+		lastError = t_("Wrong time step or duration");
+		return false;
+	}
+	int nk = int(waves.amp.size());
+	int N = 2*nk;
+	Eigen::Index numTotal = Eigen::Index(duration/dt) + 1;
+	if (nk == 0 || waves.phi.size() != nk || abs(waves.dw*N*dt - 2*M_PI) > 1E-8) {
+		lastError = t_("Wave components do not match the time step");
+		return false;
+	}
+	if (numTotal > N) {
+		lastError = t_("Wave components are shorter than the duration");
+		return false;
+	}
+	double dw = waves.dw;
+	const VectorXd &amp = waves.amp, &phi = waves.phi;
+	
+	int ih = FindClosest(qtfhead, head);
+	
+	// Dense QTF, completed with T(ωk, ωj) = conj(T(ωj, ωk))
+	int nq = qtfw.size();
+	Upp::Array<MatrixXcd> qtf(6);
+	MatrixXi filled = MatrixXi::Zero(nq, nq);
+	for (int idf = 0; idf < 6; ++idf)
+		qtf[idf].setZero(nq, nq);
+	for (const QTF &q : qtfdif) {
+		if (q.ib != ib || q.ih1 != ih || q.ih2 != ih)
+			continue;
+		filled(q.ifr1, q.ifr2) = 1;
+		for (int idf = 0; idf < 6; ++idf)
+			if (!IsNull(q.fre[idf]))
+				qtf[idf](q.ifr1, q.ifr2) = Complex(F_dim(q.fre[idf], idf), F_dim(q.fim[idf], idf));
+	}
+	if (filled.sum() == 0) {
+		lastError = Format(t_("No QTF found for body %d and heading %f"), ib+1, qtfhead[ih]);
+		return false;
+	}
+	for (int r = 0; r < nq; ++r)
+		for (int c = 0; c < nq; ++c)
+			if (!filled(r, c) && filled(c, r))
+				for (int idf = 0; idf < 6; ++idf)
+					qtf[idf](r, c) = conj(qtf[idf](c, r));
+	
+	// Brackets of the wave frequencies in the QTF frequencies
+	Upp::Vector<int> idw = GetSortOrder(qtfw);
+	double minW = qtfw[idw[0]], maxW = qtfw[idw.Top()];
+	int k0 = max(1, int(ceil(minW/dw))), k1 = min(nk-1, int(maxW/dw));
+	if (k1 < k0) {
+		lastError = t_("QTF frequencies are out of the wave realisation frequencies");
+		return false;
+	}
+	Upp::Vector<int> iq0(nk, -1), iq1(nk, -1);
+	Upp::Vector<double> tq(nk, 0.);
+	for (int k = k0, j = 0; k <= k1; ++k) {
+		double ww = k*dw;
+		while (j < nq-2 && qtfw[idw[j+1]] < ww)
+			j++;
+		iq0[k] = idw[j];
+		iq1[k] = idw[j+1];
+		double w0 = qtfw[iq0[k]], w1 = qtfw[iq1[k]];
+		tq[k] = w1 > w0 ? minmax((ww - w0)/(w1 - w0), 0., 1.) : 0;
+	}
+	auto GetT = [&](const MatrixXcd &T, int kj, int kk)->Complex {		// Bilinear
+		double tj = tq[kj], tk = tq[kk];
+		return (1-tj)*((1-tk)*T(iq0[kj], iq0[kk]) + tk*T(iq0[kj], iq1[kk])) + 
+				   tj*((1-tk)*T(iq1[kj], iq0[kk]) + tk*T(iq1[kj], iq1[kk]));
+	};
+	
+	int maxm = k1 - k0;
+	if (!IsNull(maxDiffW) && maxDiffW > 0)
+		maxm = min(maxm, int(maxDiffW/dw));
+	
+	f.setZero(numTotal, 6);
+	CoWork co;
+	for (int idf = 0; idf < 6; ++idf) {
+		co & [&, idf] {
+			const MatrixXcd &T = qtf[idf];
+			if (T.isZero())
+				return;
+			FFT<double> fft;
+			VectorXcd res;
+			if (newman) {
+				VectorXcd specp = VectorXcd::Zero(N), specn = VectorXcd::Zero(N), resn;
+				for (int k = k0; k <= k1; ++k) {
+					double d = GetT(T, k, k).real();
+					Complex b = std::polar(amp(k)*sqrt(abs(d)), phi(k));
+					if (d >= 0)
+						specp(k) = b;
+					else
+						specn(k) = b;
+				}
+				fft.inv(res, specp);
+				fft.inv(resn, specn);
+				for (Eigen::Index it = 0; it < numTotal; ++it)
+					f(it, idf) = sqr(N)*(std::norm(res(it)) - std::norm(resn(it)));
+			} else {
+				VectorXcd spec = VectorXcd::Zero(N);
+				for (int m = 0; m <= maxm; ++m) {
+					Complex D = 0;
+					for (int k = k0; k + m <= k1; ++k)
+						D += amp(k+m)*amp(k)*GetT(T, k+m, k)*std::polar(1., phi(k+m) - phi(k));
+					spec(m) = (m == 0 ? 1. : 2.)*D;
+				}
+				fft.inv(res, spec);
+				for (Eigen::Index it = 0; it < numTotal; ++it)
+					f(it, idf) = N*res(it).real();
+			}
+		};
+	}
+	co.Finish();
+	return true;
+}
+
+// Saves the header of the excitation and, if slowDrift, slow drift forces of Nb bodies in FAST .out text format.
+// The series are added later with SaveForceTimeSeries(), so they do not need to be in memory
+void Hydro::SaveForceTimeSeriesHeader(Stream &out, int Nb, bool slowDrift) {
+	static const char *names[] = {"Surge", "Sway", "Heave", "Roll", "Pitch", "Yaw"};
+
+	String parameters = "Time", units = "(s)";
+	for (int i = 0; i < (slowDrift ? 2 : 1); ++i) {
+		for (int idf = 0; idf < 6*Nb; ++idf) {
+			int ib = idf/6, id = idf - 6*ib;
+			parameters << "\t" << (i == 0 ? "Fex" : "Fsd") << (ib == 0 ? String() : FormatInt(ib+1)) << names[id];
+			units << "\t" << (id < 3 ? "(N)" : "(N-m)");
+		}
+	}
+	out << parameters << "\n" << units << "\n";
+}
+
+// Adds the rows of f, from time t0, to a file started with SaveForceTimeSeriesHeader()
+void Hydro::SaveForceTimeSeries(Stream &out, double t0, double dt, const MatrixXd &f) {
+	for (Eigen::Index it = 0; it < f.rows(); ++it) {
+		out << FormatDouble(t0 + it*dt, 8, FD_EXP);
+		for (Eigen::Index c = 0; c < f.cols(); ++c)
+			out << "\t" << FormatDouble(f(it, c), 8, FD_EXP);
+		out << "\n";
+	}
+}
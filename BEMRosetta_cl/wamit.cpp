@@ -4,6 +4,7 @@
 
 
 bool Wamit::Load(String file) {
+	BEM_PROFILE("Wamit::Load");
 	hd().code = Hydro::WAMIT;
 	hd().file = file;	
 	hd().name = GetFileTitle(file);
@@ -101,6 +102,7 @@ bool Wamit::Load(String file) {
 }
 
 void Wamit::Save(String file, bool force_T, int qtfHeading) {
+	BEM_PROFILE("Wamit::Save");
 	try {
 		if (hd().IsLoadedA() && hd().IsLoadedB()) {
 			String file1 = ForceExt(file, ".1");
@@ -137,6 +139,7 @@ void Wamit::Save(String file, bool force_T, int qtfHeading) {
 }
 
 bool Wamit::Load_out() {
+	BEM_PROFILE("Wamit::Load_out");
 	hd().Nb = 0;
 	hd().Nf = 0;
 	hd().Nh = 0;
@@ -442,6 +445,7 @@ void Wamit::Save_RAO(FileOut &out, int ifr) {
 }
 
 void Wamit::Save_out(String file, double g, double rho) {
+	BEM_PROFILE("Wamit::Save_out");
 	FileOut out(file);
 	if (!out.IsOpen())
 		throw Exc(Format(t_("Impossible to open '%s'"), file));
@@ -565,6 +569,7 @@ void Wamit::Load_A(FileInLine &in, Eigen::MatrixXd &A) {
 }
 
 bool Wamit::Load_Scattering(String fileName) {
+	BEM_PROFILE("Wamit::Load_Scattering");
 	FileInLine in(fileName);
 	if (!in.IsOpen())
 		return false;
@@ -593,6 +598,7 @@ bool Wamit::Load_Scattering(String fileName) {
 }
 		
 bool Wamit::Load_FK(String fileName) {
+	BEM_PROFILE("Wamit::Load_FK");
 	FileInLine in(fileName);
 	if (!in.IsOpen())
 		return false;
@@ -732,6 +738,7 @@ void Wamit::ProcessFirstColumn(Vector<double> &w, Vector<double> &T) {
 }
 
 bool Wamit::Load_1(String fileName) {
+	BEM_PROFILE("Wamit::Load_1");
 	hd().dimen = false;
 	hd().len = 1;
 	
@@ -857,6 +864,7 @@ bool Wamit::Load_1(String fileName) {
 }
 
 bool Wamit::Load_3(String fileName) {
+	BEM_PROFILE("Wamit::Load_3");
 	hd().dimen = false;
 	hd().len = 1;
 	
@@ -960,6 +968,7 @@ bool Wamit::Load_3(String fileName) {
 }
 
 bool Wamit::Load_hst(String fileName) {
+	BEM_PROFILE("Wamit::Load_hst");
 	hd().dimen = false;
 	if (IsNull(hd().len))
 		hd().len = 1;
@@ -1016,6 +1025,7 @@ bool Wamit::Load_hst(String fileName) {
 }
 
 bool Wamit::Load_4(String fileName) {
+	BEM_PROFILE("Wamit::Load_4");
 	hd().dimen = false;
 	if (IsNull(hd().len))
 		hd().len = 1;
@@ -1128,6 +1138,7 @@ bool Wamit::Load_4(String fileName) {
 }
 
 bool Wamit::Load_12(String fileName, bool isSum) {
+	BEM_PROFILE("Wamit::Load_12");
 	hd().dimen = false;
 	if (IsNull(hd().len))
 		hd().len = 1;
@@ -1295,6 +1306,7 @@ bool Wamit::Load_12(String fileName, bool isSum) {
 }
 
 void Wamit::Save_1(String fileName, bool force_T) {
+	BEM_PROFILE("Wamit::Save_1");
 	if (!(hd().IsLoadedA() && hd().IsLoadedB())) 
 		return;
 		
@@ -1351,6 +1363,7 @@ void Wamit::Save_1(String fileName, bool force_T) {
 }
 
 void Wamit::Save_3(String fileName, bool force_T) {
+	BEM_PROFILE("Wamit::Save_3");
 	if (!hd().IsLoadedFex()) 
 		return;
 	
@@ -1392,6 +1405,7 @@ void Wamit::Save_3(String fileName, bool force_T) {
 }
 
 void Wamit::Save_hst(String fileName) {
+	BEM_PROFILE("Wamit::Save_hst");
 	if (!hd().IsLoadedC()) 
 		return;
 		
@@ -1426,6 +1440,7 @@ void Wamit::Save_hst_static(Eigen::MatrixXd C, String fileName, double rho, doub
 }
 
 void Wamit::Save_4(String fileName, bool force_T) {
+	BEM_PROFILE("Wamit::Save_4");
 	if (!hd().IsLoadedRAO()) 
 		return;
 		
@@ -1467,6 +1482,7 @@ void Wamit::Save_4(String fileName, bool force_T) {
 }
 	
 void Wamit::Save_12(String fileName, bool isSum, bool force_T, bool force_Deg, int qtfHeading) {
+	BEM_PROFILE("Wamit::Save_12");
 	if (!hd().IsLoadedQTF()) 
 		return;
 	
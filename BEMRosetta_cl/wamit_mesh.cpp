@@ -3,19 +3,15 @@
 
 
 String MeshData::LoadDatWamit(String fileName) {
-	FileInLine in(fileName);
-	if (!in.IsOpen()) 
+	MeshScan in;
+	if (!in.Open(fileName)) 
 		return Format(t_("Impossible to open file '%s'"), fileName);
 	
 	this->fileName = fileName;
 	SetCode(MeshData::WAMIT_DAT);
 	
 	try {
-		String line;
-		FieldSplit f(in);
-		f.IsSeparator = IsTabSpace;
-		
-		line = ToUpper(TrimBoth(in.GetLine()));
+		String line = ToUpper(TrimBoth(in.GetLine()));
 		if (!line.StartsWith("ZONE"))
 			return in.Str() + "\n"  + t_("'ZONE' field not found");	// To detect Wamit format
 	
@@ -40,21 +36,22 @@ String MeshData::LoadDatWamit(String fileName) {
 		if (pos > 0) 
 			F = line.Mid(pos);
 		
+		if (IsNull(I))
+			return in.Str() + "\n"  + t_("'I' field not found");
+		
 		if (IsNull(T)) {
+			if (IsNull(J))
+				return in.Str() + "\n"  + t_("'J' field not found");
+			mesh.nodes.Reserve(I*J);
+			mesh.panels.Reserve((I-1)*(J-1));
 			while(!in.IsEof()) {
 				int id0 = mesh.nodes.size();
 				for (int i = 0; i < I*J; ++i) {
-					line = in.GetLine();	
-					f.Load(line);
-					
-					double x = f.GetDouble(0);	
-					double y = f.GetDouble(1);	
-					double z = f.GetDouble(2);	
-						
 					Point3D &node = mesh.nodes.Add();
-					node.x = x;
-					node.y = y;
-					node.z = z;
+					node.x = in.GetDouble();
+					node.y = in.GetDouble();
+					node.z = in.GetDouble();
+					in.NextLine();
 				}
 				for (int i = 0; i < I-1; ++i) {
 					for (int j = 0; j < J-1; ++j) {
@@ -65,29 +62,23 @@ String MeshData::LoadDatWamit(String fileName) {
 						panel.id[3] = id0 + I*(j+1) + i+1;
 					}
 				}
-				in.GetLine();
+				in.NextLine();
 			}
 		} else {
+			mesh.nodes.Reserve(I);
+			mesh.panels.Reserve(I/4);
 			for (int i = 0; i < I; ++i) {
-				line = in.GetLine();	
-				f.Load(line);
-				
-				double x = f.GetDouble(0);	
-				double y = f.GetDouble(1);	
-				double z = f.GetDouble(2);	
-					
 				Point3D &node = mesh.nodes.Add();
-				node.x = x;
-				node.y = y;
-				node.z = z;
+				node.x = in.GetDouble();
+				node.y = in.GetDouble();
+				node.z = in.GetDouble();
+				in.NextLine();
 			}
 			for (int i = 0; i < I/4; ++i) {
-				line = in.GetLine();	
-				f.Load(line);
-				
 				Panel &panel = mesh.panels.Add();
 				for (int ii = 0; ii < 4; ++ii)
-					panel.id[ii] = f.GetInt(ii) - 1;
+					panel.id[ii] = in.GetInt() - 1;
+				in.NextLine();
 			}
 		}
 	} catch (Exc e) {
@@ -98,68 +89,48 @@ String MeshData::LoadDatWamit(String fileName) {
 }
 	
 String MeshData::LoadGdfWamit(String fileName, bool &y0z, bool &x0z) {
-	FileInLine in(fileName);
-	if (!in.IsOpen()) 
+	MeshScan in;
+	if (!in.Open(fileName)) 
 		return Format(t_("Impossible to open file '%s'"), fileName);
 	
 	SetCode(MeshData::WAMIT_GDF);
 	
 	try {
-		String line;
-		FieldSplit f(in);	
-		f.IsSeparator = IsTabSpace;
-		
-		in.GetLine();
-		line = in.GetLine();	
-		f.Load(line);
-		double len = f.GetDouble(0);
+		in.NextLine();
+		double len = in.GetDouble();
 		if (len < 1)
 			return t_("Wrong length scale in .gdf file");
-					
-		line = in.GetLine();	
-		f.Load(line);
-		y0z = f.GetInt(0) != 0;
-		x0z = f.GetInt(1) != 0;
+		in.NextLine();
+		
+		y0z = in.GetInt() != 0;
+		x0z = in.GetInt() != 0;
+		in.NextLine();
 		
-		line = in.GetLine();	
-		f.Load(line);
-		int nPatches = f.GetInt(0);
+		int nPatches = in.GetInt();
 		if (nPatches < 1)
 			return t_("Number of patches not found in .gdf file");
+		in.NextLine();
 				
 		mesh.Clear();
+		mesh.nodes.Reserve(4*nPatches);
+		mesh.panels.Reserve(nPatches);
+		NodeWelder welder(mesh.nodes);
 		
 		while(!in.IsEof()) {
 			int ids[4];
 			bool npand = false;
 			for (int i = 0; i < 4; ++i) {
-				line = in.GetLine();	
-				f.Load(line);
-				
-				if (f.GetText(1) == "NPAND") { // Dipoles loaded as normal panels
+				if (in.LineContains("NPAND")) { // Dipoles loaded as normal panels
+					in.NextLine();
 					npand = true;
 					break;
 				}
-				double x = f.GetDouble(0)*len;	
-				double y = f.GetDouble(1)*len;	
-				double z = f.GetDouble(2)*len;	
+				double x = in.GetDouble()*len;	
+				double y = in.GetDouble()*len;	
+				double z = in.GetDouble()*len;	
+				in.NextLine();
 				
-				bool found = false;
-				for (int iin = 0; iin < mesh.nodes.size(); ++iin) {
-					Point3D &node = mesh.nodes[iin];
-					if (x == node.x && y == node.y && z == node.z) {
-						ids[i] = iin;
-						found = true;
-						break;
-					}
-				}
-				if (!found) {
-					Point3D &node = mesh.nodes.Add();
-					node.x = x;
-					node.y = y;
-					node.z = z;
-					ids[i] = mesh.nodes.size() - 1;
-				}
+				ids[i] = welder.Add(Point3D(x, y, z));
 			}
 			if (!npand) {
 				Panel &panel = mesh.panels.Add();